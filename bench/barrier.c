@@ -0,0 +1,91 @@
+/*
+ * ISC License
+ *
+ * Copyright (c) 2022, Tommi Leino <namhas@gmail.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * barrier.c:
+ *   Waits for a running mxswm to handle all events caused by the
+ *   benchmarks, using the ctl 'barrier' command. Unlike mapping a
+ *   marker window, this does not change the focus or the stacks
+ *   being measured.
+ */
+
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <err.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+static void	 ctl_request(const char *);
+
+/*
+ * Does a ctl request over the mxswm socket and waits for the reply.
+ */
+static void
+ctl_request(const char *line)
+{
+	struct sockaddr_un addr;
+	char *home, buf[256];
+	size_t len;
+	ssize_t n;
+	int fd;
+
+	home = getenv("HOME");
+	if (home == NULL)
+		home = "/";
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (snprintf(addr.sun_path, sizeof(addr.sun_path),
+	    "%s/.mxswm_socket", home) >= sizeof(addr.sun_path))
+		errx(1, "socket path truncated");
+
+	if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1)
+		err(1, "socket");
+	if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) == -1)
+		err(1, "connect %s", addr.sun_path);
+	if (write(fd, line, strlen(line)) == -1 || write(fd, "\n", 1) == -1)
+		err(1, "write");
+	shutdown(fd, SHUT_WR);
+
+	len = 0;
+	while ((n = read(fd, buf + len, sizeof(buf) - 1 - len)) > 0)
+		if ((len += n) == sizeof(buf) - 1)
+			break;
+	if (n == -1)
+		err(1, "read");
+	buf[len] = '\0';
+	close(fd);
+
+	if (strncmp(buf, "ok", strlen("ok")) != 0)
+		errx(1, "'%s' failed: %s", line, buf);
+}
+
+/*
+ * Waits until mxswm has handled all events caused so far.
+ */
+void
+barrier(Display *dpy)
+{
+	XSync(dpy, False);
+	ctl_request("barrier");
+	XSync(dpy, False);
+}
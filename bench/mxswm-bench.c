@@ -0,0 +1,263 @@
+/*
+ * ISC License
+ *
+ * Copyright (c) 2022, Tommi Leino <namhas@gmail.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * mxswm-bench.c:
+ *   Runs scripted scenarios against a running mxswm and writes one
+ *   JSON object per scenario with the wall time, and the CPU time and
+ *   X requests mxswm used, which are asked using mxswmctl.
+ *
+ *   Key bindings are driven by sending synthetic key releases to the
+ *   root window, which mxswm handles like real ones.
+ *
+ *   After each scenario the benchmark waits with barrier() until
+ *   mxswm has handled all events caused by it, without creating any
+ *   windows of its own that would disturb the focus and the stacks.
+ */
+
+#include "bench.h"
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/keysym.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <err.h>
+#include <unistd.h>
+
+struct totals {
+	unsigned long requests;
+	unsigned long round_trips;
+	double cpu_ms;
+};
+
+static Display *dpy;
+static Window *windows;
+static int nwindows;
+static FILE *out;
+static const char *label;
+
+static double	 now_ms(void);
+static void	 get_totals(struct totals *);
+static void	 send_key(KeySym);
+static void	 run(const char *, int, void (*)(int));
+static void	 map_windows(int);
+static void	 cycle_focus(int);
+static void	 cycle_stacks(int);
+static void	 spam_titles(int);
+static void	 destroy_windows(int);
+
+static double
+now_ms()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+/*
+ * Asks mxswm for its totals with 'mxswmctl stats total'.
+ */
+static void
+get_totals(struct totals *t)
+{
+	FILE *fp;
+	const char *ctl;
+	char cmd[1024];
+
+	ctl = getenv("MXSWMCTL");
+	if (ctl == NULL)
+		ctl = "mxswmctl";
+
+	if (snprintf(cmd, sizeof(cmd), "%s stats total", ctl) >= sizeof(cmd))
+		errx(1, "MXSWMCTL too long");
+
+	fp = popen(cmd, "r");
+	if (fp == NULL)
+		err(1, "%s", cmd);
+	if (fscanf(fp, "requests %lu round_trips %lu cpu_ms %lf",
+	    &t->requests, &t->round_trips, &t->cpu_ms) != 3)
+		errx(1, "unexpected reply to '%s'", cmd);
+	pclose(fp);
+}
+
+static void
+send_key(KeySym sym)
+{
+	XKeyEvent e;
+
+	memset(&e, 0, sizeof(e));
+	e.type = KeyRelease;
+	e.display = dpy;
+	e.window = DefaultRootWindow(dpy);
+	e.root = DefaultRootWindow(dpy);
+	e.time = CurrentTime;
+	e.same_screen = True;
+	e.keycode = XKeysymToKeycode(dpy, sym);
+	if (e.keycode == 0)
+		errx(1, "no keycode for %s", XKeysymToString(sym));
+
+	XSendEvent(dpy, DefaultRootWindow(dpy), False, KeyReleaseMask,
+	    (XEvent *) &e);
+}
+
+static void
+run(const char *scenario, int n, void (*fn)(int))
+{
+	struct totals before, after;
+	double t0, t1;
+
+	get_totals(&before);
+	t0 = now_ms();
+	fn(n);
+	barrier(dpy);
+	t1 = now_ms();
+	get_totals(&after);
+
+	fprintf(out, "{\"label\":\"%s\",\"scenario\":\"%s\",\"n\":%d,"
+	    "\"wall_ms\":%.3f,\"cpu_ms\":%.3f,\"requests\":%lu,"
+	    "\"round_trips\":%lu}\n", label, scenario, n, t1 - t0,
+	    after.cpu_ms - before.cpu_ms,
+	    after.requests - before.requests,
+	    after.round_trips - before.round_trips);
+	fflush(out);
+}
+
+static void
+map_windows(int n)
+{
+	char name[64];
+	int i;
+
+	windows = calloc(n, sizeof(Window));
+	if (windows == NULL)
+		err(1, "calloc");
+
+	for (i = 0; i < n; i++) {
+		windows[i] = XCreateSimpleWindow(dpy, DefaultRootWindow(dpy),
+		    0, 0, 100, 100, 0, 0, WhitePixel(dpy, DefaultScreen(dpy)));
+		snprintf(name, sizeof(name), "bench %d", i);
+		XStoreName(dpy, windows[i], name);
+		XMapWindow(dpy, windows[i]);
+	}
+	nwindows = n;
+}
+
+static void
+cycle_focus(int n)
+{
+	int i;
+
+	for (i = 0; i < n; i++)
+		send_key(XK_Menu);
+}
+
+static void
+cycle_stacks(int n)
+{
+	int i;
+
+	for (i = 0; i < n; i++) {
+		send_key(XK_F2);
+		send_key(XK_F1);
+	}
+}
+
+static void
+spam_titles(int n)
+{
+	char name[64];
+	int i;
+
+	for (i = 0; i < n; i++) {
+		snprintf(name, sizeof(name), "bench title %d", i);
+		XStoreName(dpy, windows[i % nwindows], name);
+	}
+}
+
+static void
+destroy_windows(int n)
+{
+	int i;
+
+	for (i = 0; i < n; i++)
+		XDestroyWindow(dpy, windows[i]);
+	nwindows = 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+	int ch, nwin, nfocus, nstack, ntitle;
+
+	nwin = 500;
+	nfocus = 10000;
+	nstack = 100;
+	ntitle = 10000;
+	label = "";
+	out = stdout;
+
+	while ((ch = getopt(argc, argv, "f:l:n:o:s:t:")) != -1) {
+		switch (ch) {
+		case 'f':
+			nfocus = atoi(optarg);
+			break;
+		case 'l':
+			label = optarg;
+			break;
+		case 'n':
+			nwin = atoi(optarg);
+			break;
+		case 'o':
+			out = fopen(optarg, "a");
+			if (out == NULL)
+				err(1, "%s", optarg);
+			break;
+		case 's':
+			nstack = atoi(optarg);
+			break;
+		case 't':
+			ntitle = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-l label] [-o file] "
+			    "[-n windows] [-f focus] [-s stacks] [-t titles]\n",
+			    argv[0]);
+			return 1;
+		}
+	}
+	if (nwin < 1)
+		errx(1, "need at least one window");
+
+	if ((dpy = XOpenDisplay(NULL)) == NULL)
+		errx(1, "cannot open display");
+
+	barrier(dpy);
+	run("map", nwin, map_windows);
+	run("focus", nfocus, cycle_focus);
+	run("stacks", nstack, cycle_stacks);
+	run("titles", ntitle, spam_titles);
+	run("destroy", nwin, destroy_windows);
+
+	XCloseDisplay(dpy);
+	return 0;
+}
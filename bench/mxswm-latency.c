@@ -0,0 +1,421 @@
+/*
+ * ISC License
+ *
+ * Copyright (c) 2022, Tommi Leino <namhas@gmail.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * mxswm-latency.c:
+ *   Measures the latency of keyboard-driven window switching in a
+ *   running mxswm.
+ *
+ *   Key sequences are injected with XTest, and the time is measured
+ *   until the effect is visible on the server: either focus moves to
+ *   one of our windows (FocusIn), or mxswm draws something (a Damage
+ *   event on the root window). Percentiles are reported as one JSON
+ *   object per scenario and number of clients.
+ *
+ *   Between iterations the benchmark waits until mxswm has finished
+ *   the previous one with barrier(): after XSync() the ctl 'barrier'
+ *   command makes mxswm handle every event the server has sent it and
+ *   paint before it replies.
+ */
+
+#include "bench.h"
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/keysym.h>
+#include <X11/extensions/XTest.h>
+#include <X11/extensions/Xdamage.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <err.h>
+#include <poll.h>
+#include <unistd.h>
+
+#define TIMEOUT_MS 1000
+
+enum effect {
+	EFFECT_FOCUS,
+	EFFECT_DAMAGE
+};
+
+static Display *dpy;
+static Window *windows;
+static int nwindows;
+static Window focused;
+static Damage damage;
+static int damage_event;
+static FILE *out;
+static const char *label;
+static double *samples;
+static int nsamples;
+static int timeouts;
+
+static double	 now_ms(void);
+static void	 settle(void);
+static void	 key(KeySym, Bool);
+static void	 tap(KeySym);
+static int	 wait_effect(int, double, double *);
+static void	 sample(int, double);
+static int	 compare(const void *, const void *);
+static void	 report(const char *, int);
+static void	 map_windows(int);
+static void	 bench_win_right(int);
+static void	 bench_win_tab(int);
+static void	 bench_win_down(int);
+static void	 bench_prompt(int);
+
+static double
+now_ms()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+/*
+ * Waits until mxswm is idle and forgets the events seen so far.
+ */
+static void
+settle()
+{
+	XEvent e;
+
+	barrier(dpy);
+	while (XPending(dpy)) {
+		XNextEvent(dpy, &e);
+		if (e.type == FocusIn)
+			focused = e.xfocus.window;
+	}
+	XDamageSubtract(dpy, damage, None, None);
+	XSync(dpy, False);
+}
+
+static void
+key(KeySym sym, Bool press)
+{
+	KeyCode code;
+
+	code = XKeysymToKeycode(dpy, sym);
+	if (code == 0)
+		errx(1, "no keycode for %s", XKeysymToString(sym));
+	XTestFakeKeyEvent(dpy, code, press, CurrentTime);
+}
+
+static void
+tap(KeySym sym)
+{
+	key(sym, True);
+	key(sym, False);
+}
+
+/*
+ * Waits for the given effect. Returns 0 and the time since 'start' in
+ * '*ms', or -1 on timeout.
+ */
+static int
+wait_effect(int effect, double start, double *ms)
+{
+	struct pollfd pfd;
+	XEvent e;
+	double now;
+
+	pfd.fd = ConnectionNumber(dpy);
+	pfd.events = POLLIN;
+
+	for (;;) {
+		while (XPending(dpy)) {
+			XNextEvent(dpy, &e);
+			now = now_ms();
+			if (e.type == FocusIn && e.xfocus.window != focused) {
+				focused = e.xfocus.window;
+				if (effect == EFFECT_FOCUS) {
+					*ms = now - start;
+					return 0;
+				}
+			} else if (e.type == damage_event + XDamageNotify &&
+			    effect == EFFECT_DAMAGE) {
+				*ms = now - start;
+				return 0;
+			}
+		}
+		now = now_ms();
+		if (now - start >= TIMEOUT_MS)
+			return -1;
+		poll(&pfd, 1, TIMEOUT_MS - (now - start));
+	}
+}
+
+/*
+ * Flushes the injected keys and records the time until the effect.
+ */
+static void
+sample(int effect, double start)
+{
+	double ms;
+
+	XFlush(dpy);
+	if (wait_effect(effect, start, &ms) == -1) {
+		timeouts++;
+		return;
+	}
+	samples[nsamples++] = ms;
+}
+
+static int
+compare(const void *a, const void *b)
+{
+	double x = *(const double *) a, y = *(const double *) b;
+
+	return (x > y) - (x < y);
+}
+
+static void
+report(const char *scenario, int iterations)
+{
+	double p50, p90, p99, max;
+
+	p50 = p90 = p99 = max = 0.0;
+	if (nsamples > 0) {
+		qsort(samples, nsamples, sizeof(double), compare);
+		p50 = samples[(nsamples - 1) * 50 / 100];
+		p90 = samples[(nsamples - 1) * 90 / 100];
+		p99 = samples[(nsamples - 1) * 99 / 100];
+		max = samples[nsamples - 1];
+	}
+
+	fprintf(out, "{\"label\":\"%s\",\"scenario\":\"%s\","
+	    "\"clients\":%d,\"iterations\":%d,\"samples\":%d,"
+	    "\"timeouts\":%d,\"p50_ms\":%.3f,\"p90_ms\":%.3f,"
+	    "\"p99_ms\":%.3f,\"max_ms\":%.3f}\n", label, scenario,
+	    nwindows, iterations, nsamples, timeouts, p50, p90, p99, max);
+	fflush(out);
+
+	nsamples = 0;
+	timeouts = 0;
+}
+
+/*
+ * Maps windows until there are 'n', half of them to the other stack.
+ */
+static void
+map_windows(int n)
+{
+	char name[64];
+	int i, half;
+
+	windows = realloc(windows, n * sizeof(Window));
+	if (windows == NULL)
+		err(1, "realloc");
+
+	half = nwindows + (n - nwindows) / 2;
+	for (i = nwindows; i < n; i++) {
+		if (i == half) {
+			settle();
+			key(XK_Super_L, True);
+			tap(XK_Right);
+			key(XK_Super_L, False);
+			settle();
+		}
+		windows[i] = XCreateSimpleWindow(dpy, DefaultRootWindow(dpy),
+		    0, 0, 100, 100, 0, 0, WhitePixel(dpy, DefaultScreen(dpy)));
+		XSelectInput(dpy, windows[i], FocusChangeMask);
+		snprintf(name, sizeof(name), "latency %d", i);
+		XStoreName(dpy, windows[i], name);
+		XMapWindow(dpy, windows[i]);
+	}
+	nwindows = n;
+	settle();
+}
+
+/*
+ * Win+Right moves focus to the other stack.
+ */
+static void
+bench_win_right(int iterations)
+{
+	double start;
+	int i;
+
+	for (i = 0; i < iterations; i++) {
+		start = now_ms();
+		key(XK_Super_L, True);
+		tap(XK_Right);
+		key(XK_Super_L, False);
+		sample(EFFECT_FOCUS, start);
+		settle();
+	}
+	report("win-right", iterations);
+}
+
+/*
+ * Win+Tab focuses the next window when Win is released.
+ */
+static void
+bench_win_tab(int iterations)
+{
+	double start;
+	int i;
+
+	for (i = 0; i < iterations; i++) {
+		start = now_ms();
+		key(XK_Super_L, True);
+		tap(XK_Tab);
+		key(XK_Super_L, False);
+		sample(EFFECT_FOCUS, start);
+		settle();
+	}
+	report("win-tab", iterations);
+}
+
+/*
+ * Win+Down opens the menu or moves the selection, which is measured
+ * as a repaint. Releasing Win then selects the window.
+ */
+static void
+bench_win_down(int iterations)
+{
+	double start;
+	int i;
+
+	for (i = 0; i < iterations; i++) {
+		key(XK_Super_L, True);
+		start = now_ms();
+		tap(XK_Down);
+		sample(EFFECT_DAMAGE, start);
+		key(XK_Super_L, False);
+		settle();
+	}
+	report("win-down", iterations);
+}
+
+/*
+ * Win+f opens the find prompt, and typing repaints it.
+ */
+static void
+bench_prompt(int iterations)
+{
+	static const KeySym typed[] = { XK_l, XK_a, XK_t, XK_e };
+	double start;
+	int i, j;
+
+	for (i = 0; i < iterations; i++) {
+		start = now_ms();
+		key(XK_Super_L, True);
+		tap(XK_f);
+		key(XK_Super_L, False);
+		sample(EFFECT_DAMAGE, start);
+		settle();
+	}
+	report("win-f", iterations);
+
+	for (i = 0; i < iterations; i++) {
+		key(XK_Super_L, True);
+		tap(XK_f);
+		key(XK_Super_L, False);
+		settle();
+		for (j = 0; j < sizeof(typed) / sizeof(typed[0]); j++) {
+			start = now_ms();
+			tap(typed[j]);
+			sample(EFFECT_DAMAGE, start);
+			settle();
+		}
+		tap(XK_Escape);
+		settle();
+	}
+	report("prompt-typing", iterations);
+}
+
+int
+main(int argc, char *argv[])
+{
+	char clients[256], *p;
+	int ch, iterations, n, maj, min, ev, er;
+
+	iterations = 1000;
+	strcpy(clients, "10,100,1000");
+	label = "";
+	out = stdout;
+
+	while ((ch = getopt(argc, argv, "c:i:l:o:")) != -1) {
+		switch (ch) {
+		case 'c':
+			if (snprintf(clients, sizeof(clients), "%s",
+			    optarg) >= sizeof(clients))
+				errx(1, "client counts too long");
+			break;
+		case 'i':
+			iterations = atoi(optarg);
+			break;
+		case 'l':
+			label = optarg;
+			break;
+		case 'o':
+			out = fopen(optarg, "a");
+			if (out == NULL)
+				err(1, "%s", optarg);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-l label] [-o file] "
+			    "[-i iterations] [-c clients,...]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (iterations < 1)
+		errx(1, "need at least one iteration");
+
+	/*
+	 * The prompt measures four key presses per iteration.
+	 */
+	samples = calloc(iterations * 4, sizeof(double));
+	if (samples == NULL)
+		err(1, "calloc");
+
+	if ((dpy = XOpenDisplay(NULL)) == NULL)
+		errx(1, "cannot open display");
+	if (!XTestQueryExtension(dpy, &ev, &er, &maj, &min))
+		errx(1, "no XTest extension");
+	if (!XDamageQueryExtension(dpy, &damage_event, &er))
+		errx(1, "no Damage extension");
+	damage = XDamageCreate(dpy, DefaultRootWindow(dpy),
+	    XDamageReportNonEmpty);
+
+	/*
+	 * Add a second stack for Win+Right to move between.
+	 */
+	tap(XK_F2);
+	settle();
+
+	for (p = strtok(clients, ","); p != NULL; p = strtok(NULL, ",")) {
+		n = atoi(p);
+		if (n <= nwindows)
+			continue;
+		map_windows(n);
+
+		bench_win_right(iterations);
+		bench_win_tab(iterations);
+		bench_win_down(iterations);
+		bench_prompt(iterations);
+	}
+
+	XCloseDisplay(dpy);
+	return 0;
+}
@@ -0,0 +1,302 @@
+/*
+ * ISC License
+ *
+ * Copyright (c) 2022, Tommi Leino <namhas@gmail.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * mxswm-soak.c:
+ *   Drives window churn, title changes and stack changes through a
+ *   running mxswm for a long time and samples its memory use with
+ *   'mxswmctl stats memory'. One JSON object is written per sample.
+ *
+ *   After a warmup of a quarter of the run, the resident set size and
+ *   the heap in use must not grow more than the given percentage, or
+ *   the run fails.
+ */
+
+#include "bench.h"
+
+#include <X11/Xlib.h>
+#include <X11/Xatom.h>
+#include <X11/keysym.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <err.h>
+#include <unistd.h>
+
+/*
+ * Growth below this many kilobytes is never counted as a leak.
+ */
+#define SLACK_KB 1024
+
+struct memory {
+	long rss_kb;
+	long maxrss_kb;
+	long heap_kb;
+	long heap_free_kb;
+};
+
+static Display *dpy;
+static Window *windows;
+static int nwindows;
+static Atom net_wm_name, utf8_string;
+static FILE *out;
+static const char *label;
+static unsigned long serial;
+
+static double	 now_ms(void);
+static void	 get_memory(struct memory *);
+static void	 send_key(KeySym);
+static Window	 create_window(void);
+static void	 set_title(Window);
+static void	 churn(int);
+static void	 sample(double, unsigned long, struct memory *);
+static int	 grew(const char *, long, long, int);
+
+static double
+now_ms()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+/*
+ * Asks mxswm for its memory use with 'mxswmctl stats memory'.
+ */
+static void
+get_memory(struct memory *m)
+{
+	FILE *fp;
+	const char *ctl;
+	char cmd[1024];
+
+	ctl = getenv("MXSWMCTL");
+	if (ctl == NULL)
+		ctl = "mxswmctl";
+
+	if (snprintf(cmd, sizeof(cmd), "%s stats memory", ctl) >=
+	    sizeof(cmd))
+		errx(1, "MXSWMCTL too long");
+
+	fp = popen(cmd, "r");
+	if (fp == NULL)
+		err(1, "%s", cmd);
+	if (fscanf(fp, "rss_kb %ld maxrss_kb %ld heap_kb %ld heap_free_kb %ld",
+	    &m->rss_kb, &m->maxrss_kb, &m->heap_kb, &m->heap_free_kb) != 4)
+		errx(1, "unexpected reply to '%s'", cmd);
+	pclose(fp);
+}
+
+static void
+send_key(KeySym sym)
+{
+	XKeyEvent e;
+
+	memset(&e, 0, sizeof(e));
+	e.type = KeyRelease;
+	e.display = dpy;
+	e.window = DefaultRootWindow(dpy);
+	e.root = DefaultRootWindow(dpy);
+	e.time = CurrentTime;
+	e.same_screen = True;
+	e.keycode = XKeysymToKeycode(dpy, sym);
+	if (e.keycode == 0)
+		errx(1, "no keycode for %s", XKeysymToString(sym));
+
+	XSendEvent(dpy, DefaultRootWindow(dpy), False, KeyReleaseMask,
+	    (XEvent *) &e);
+}
+
+static Window
+create_window()
+{
+	Window w;
+
+	w = XCreateSimpleWindow(dpy, DefaultRootWindow(dpy),
+	    0, 0, 100, 100, 0, 0, WhitePixel(dpy, DefaultScreen(dpy)));
+	set_title(w);
+	XMapWindow(dpy, w);
+
+	return w;
+}
+
+/*
+ * Sets both WM_NAME and _NET_WM_NAME to a title of varying length, so
+ * that mxswm keeps freeing and allocating differently sized names.
+ */
+static void
+set_title(Window w)
+{
+	char name[256];
+	int len;
+
+	serial++;
+	len = snprintf(name, sizeof(name), "soak %lu ", serial);
+	memset(&name[len], 'x', serial % (sizeof(name) - len - 1));
+	name[len + serial % (sizeof(name) - len - 1)] = '\0';
+
+	XStoreName(dpy, w, name);
+	XChangeProperty(dpy, w, net_wm_name, utf8_string, 8,
+	    PropModeReplace, (unsigned char *) name, strlen(name));
+}
+
+/*
+ * One round: replaces a tenth of the windows, retitles all of them,
+ * cycles focus and adds and removes a stack.
+ */
+static void
+churn(int round)
+{
+	int i, n;
+
+	n = nwindows / 10 > 0 ? nwindows / 10 : 1;
+	for (i = 0; i < n; i++) {
+		XDestroyWindow(dpy, windows[(round * n + i) % nwindows]);
+		windows[(round * n + i) % nwindows] = create_window();
+	}
+
+	for (i = 0; i < nwindows; i++)
+		set_title(windows[i]);
+
+	for (i = 0; i < 10; i++)
+		send_key(XK_Menu);
+
+	send_key(XK_F2);
+	send_key(XK_F1);
+
+	barrier(dpy);
+}
+
+static void
+sample(double t, unsigned long rounds, struct memory *m)
+{
+	get_memory(m);
+
+	fprintf(out, "{\"label\":\"%s\",\"scenario\":\"soak\","
+	    "\"t_s\":%.1f,\"rounds\":%lu,\"rss_kb\":%ld,\"maxrss_kb\":%ld,"
+	    "\"heap_kb\":%ld,\"heap_free_kb\":%ld}\n", label, t / 1000.0,
+	    rounds, m->rss_kb, m->maxrss_kb, m->heap_kb, m->heap_free_kb);
+	fflush(out);
+}
+
+/*
+ * Returns 1 and complains if 'what' grew more than 'percent' from
+ * 'base' to 'last'. Values of -1 are unknown and are not judged.
+ */
+static int
+grew(const char *what, long base, long last, int percent)
+{
+	if (base == -1 || last == -1)
+		return 0;
+
+	if (last - base > SLACK_KB && last > base + base * percent / 100) {
+		warnx("%s grew from %ld kB to %ld kB", what, base, last);
+		return 1;
+	}
+
+	return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+	struct memory base, m;
+	double t0, t, next;
+	unsigned long rounds;
+	int ch, i, duration, interval, percent, failed, have_base;
+
+	nwindows = 200;
+	duration = 600;
+	interval = 10;
+	percent = 10;
+	label = "";
+	out = stdout;
+
+	while ((ch = getopt(argc, argv, "d:g:i:l:n:o:")) != -1) {
+		switch (ch) {
+		case 'd':
+			duration = atoi(optarg);
+			break;
+		case 'g':
+			percent = atoi(optarg);
+			break;
+		case 'i':
+			interval = atoi(optarg);
+			break;
+		case 'l':
+			label = optarg;
+			break;
+		case 'n':
+			nwindows = atoi(optarg);
+			break;
+		case 'o':
+			out = fopen(optarg, "a");
+			if (out == NULL)
+				err(1, "%s", optarg);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-l label] [-o file] "
+			    "[-n windows] [-d seconds] [-i interval] "
+			    "[-g percent]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (nwindows < 1)
+		errx(1, "need at least one window");
+	if (interval < 1 || duration < interval * 4)
+		errx(1, "need at least four samples");
+
+	if ((dpy = XOpenDisplay(NULL)) == NULL)
+		errx(1, "cannot open display");
+	net_wm_name = XInternAtom(dpy, "_NET_WM_NAME", False);
+	utf8_string = XInternAtom(dpy, "UTF8_STRING", False);
+
+	if ((windows = calloc(nwindows, sizeof(Window))) == NULL)
+		err(1, "calloc");
+	for (i = 0; i < nwindows; i++)
+		windows[i] = create_window();
+	barrier(dpy);
+
+	have_base = 0;
+	rounds = 0;
+	t0 = now_ms();
+	next = 0;
+	while ((t = now_ms() - t0) < duration * 1000.0) {
+		churn(rounds++);
+		if (t < next)
+			continue;
+		next += interval * 1000.0;
+		sample(t, rounds, &m);
+		if (!have_base && t >= duration * 250.0) {
+			base = m;
+			have_base = 1;
+		}
+	}
+	sample(now_ms() - t0, rounds, &m);
+	if (!have_base)
+		base = m;
+
+	failed = grew("rss", base.rss_kb, m.rss_kb, percent);
+	failed |= grew("heap", base.heap_kb, m.heap_kb, percent);
+
+	XCloseDisplay(dpy);
+	return failed;
+}
@@ -0,0 +1,65 @@
+#!/bin/sh
+# Usage: ./run.sh program [options]
+#
+# Starts Xvfb and mxswm on it, runs the benchmark program and appends the
+# results to the file named by BENCH_OUTPUT, by default results.json. The
+# results are labeled with BENCH_LABEL, by default the current git
+# revision.
+
+if [ "$#" -lt 1 ] ; then
+	echo "usage: $0 program [options]" >&2
+	exit 1
+fi
+PROGRAM=$1
+shift
+
+cd "$(dirname "$0")" || exit 1
+
+BENCH_DISPLAY=${BENCH_DISPLAY:-:99}
+BENCH_OUTPUT=${BENCH_OUTPUT:-results.json}
+if [ -z "${BENCH_LABEL}" ] ; then
+	BENCH_LABEL=$(git describe --always --dirty 2>/dev/null || echo unknown)
+fi
+
+tmp=$(mktemp -d) || exit 1
+xvfb=
+mxswm=
+cleanup() {
+	[ -n "${mxswm}" ] && kill ${mxswm} 2>/dev/null
+	[ -n "${xvfb}" ] && kill ${xvfb} 2>/dev/null
+	rm -rf "${tmp}"
+}
+trap cleanup EXIT INT TERM
+
+wait_for() {
+	i=0
+	while [ ! -e "$1" ] ; do
+		i=$((i + 1))
+		if [ ${i} -gt 100 ] ; then
+			echo "timed out waiting for $1" >&2
+			exit 1
+		fi
+		sleep 0.1
+	done
+}
+
+Xvfb ${BENCH_DISPLAY} -screen 0 1920x1080x24 -nolisten tcp \
+	>"${tmp}/Xvfb.log" 2>&1 &
+xvfb=$!
+wait_for "/tmp/.X11-unix/X${BENCH_DISPLAY#:}"
+
+# A private HOME keeps the user's .mxswmrc, history and ctl socket out.
+export DISPLAY=${BENCH_DISPLAY}
+export HOME=${tmp}
+export MXSWMCTL=$(pwd)/../mxswmctl/mxswmctl
+
+../mxswm >"${tmp}/mxswm.log" 2>&1 &
+mxswm=$!
+wait_for "${tmp}/.mxswm_socket"
+
+${PROGRAM} -l "${BENCH_LABEL}" -o "${BENCH_OUTPUT}" "$@"
+ret=$?
+if [ ${ret} -ne 0 ] ; then
+	cat "${tmp}/mxswm.log" >&2
+fi
+exit ${ret}
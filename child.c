@@ -0,0 +1,248 @@
+/*
+ * ISC License
+ *
+ * Copyright (c) 2022, Tommi Leino <namhas@gmail.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * child.c:
+ *   Reaps child processes when SIGCHLD arrives instead of polling with
+ *   waitpid(2) on every event loop iteration.
+ *
+ *   On Linux, SIGCHLD is blocked and read from a signalfd(2) watched by
+ *   the event loop. Elsewhere, a signal handler writes to a pipe that
+ *   is watched instead. All finished children are reaped at once and
+ *   the most recent ones are kept for 'children' ctl command.
+ */
+
+#include "mxswm.h"
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <err.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/signalfd.h>
+#endif
+
+struct child {
+	pid_t pid;
+	char command[64];
+	struct timespec start;
+	long runtime_ms;
+	int status;
+	struct child *next;
+};
+
+#define NUM_FINISHED 16
+
+static struct child *running_children;
+static struct child finished[NUM_FINISHED];
+static size_t nfinished;
+
+static sigset_t child_mask;
+
+static void reap_children(int, void *);
+
+#ifndef __linux__
+static int child_pipe[2] = { -1, -1 };
+
+static void
+handle_sigchld(int sig)
+{
+	int saved_errno = errno;
+
+	(void) write(child_pipe[1], "", 1);
+	errno = saved_errno;
+}
+#endif
+
+static long
+elapsed_ms(struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) * 1000 +
+	    (now.tv_nsec - start->tv_nsec) / 1000000;
+}
+
+void
+watch_children()
+{
+	int fd;
+#ifndef __linux__
+	struct sigaction sa;
+#endif
+
+	sigemptyset(&child_mask);
+	sigaddset(&child_mask, SIGCHLD);
+
+#ifdef __linux__
+	if (sigprocmask(SIG_BLOCK, &child_mask, NULL) == -1)
+		err(1, "sigprocmask");
+	if ((fd = signalfd(-1, &child_mask, SFD_NONBLOCK | SFD_CLOEXEC)) ==
+	    -1)
+		err(1, "signalfd");
+#else
+	if (pipe(child_pipe) == -1)
+		err(1, "pipe");
+	fcntl(child_pipe[0], F_SETFL, O_NONBLOCK);
+	fcntl(child_pipe[1], F_SETFL, O_NONBLOCK);
+	fcntl(child_pipe[0], F_SETFD, FD_CLOEXEC);
+	fcntl(child_pipe[1], F_SETFD, FD_CLOEXEC);
+	fd = child_pipe[0];
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = handle_sigchld;
+	sa.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+	sigemptyset(&sa.sa_mask);
+	if (sigaction(SIGCHLD, &sa, NULL) == -1)
+		err(1, "sigaction");
+#endif
+
+	if (add_watch(fd, reap_children, NULL) == -1)
+		errx(1, "cannot watch children");
+
+	/*
+	 * Children may have exited before we started watching them,
+	 * e.g. across a restart.
+	 */
+	reap_children(fd, NULL);
+}
+
+/*
+ * Forks a child that is recorded until it has been reaped. Like
+ * fork(2), returns 0 in the child.
+ */
+pid_t
+fork_child(const char *command)
+{
+	struct child *child;
+	pid_t pid;
+
+	pid = fork();
+	if (pid == 0) {
+		sigprocmask(SIG_UNBLOCK, &child_mask, NULL);
+		return 0;
+	} else if (pid == -1) {
+		warn("fork");
+		return -1;
+	}
+
+	if ((child = calloc(1, sizeof(struct child))) == NULL) {
+		warn("calloc");
+		return pid;
+	}
+	child->pid = pid;
+	snprintf(child->command, sizeof(child->command), "%s", command);
+	clock_gettime(CLOCK_MONOTONIC, &child->start);
+	child->next = running_children;
+	running_children = child;
+
+	return pid;
+}
+
+static void
+child_finished(pid_t pid, int status)
+{
+	struct child **pp, *child, *f;
+
+	f = &finished[nfinished++ % NUM_FINISHED];
+	memset(f, 0, sizeof(*f));
+	f->pid = pid;
+	f->status = status;
+	f->runtime_ms = -1;
+
+	for (pp = &running_children; *pp != NULL; pp = &(*pp)->next) {
+		child = *pp;
+		if (child->pid != pid)
+			continue;
+		*pp = child->next;
+		memcpy(f->command, child->command, sizeof(f->command));
+		f->runtime_ms = elapsed_ms(&child->start);
+		free(child);
+		break;
+	}
+
+	TRACE_LOG("pid %d status %d", (int) pid, status);
+}
+
+static void
+reap_children(int fd, void *udata)
+{
+	pid_t pid;
+	int status;
+#ifdef __linux__
+	struct signalfd_siginfo si;
+
+	while (read(fd, &si, sizeof(si)) == sizeof(si))
+		;
+#else
+	char buf[64];
+
+	while (read(fd, buf, sizeof(buf)) > 0)
+		;
+#endif
+
+	while ((pid = waitpid(-1, &status, WNOHANG)) > 0)
+		child_finished(pid, status);
+}
+
+static void
+reply_child(struct child *child, const char *state, long runtime_ms)
+{
+	ctl_reply("%d %s %ld.%03lds %s\n", (int) child->pid, state,
+	    runtime_ms / 1000, runtime_ms % 1000,
+	    child->command[0] != '\0' ? child->command : "?");
+}
+
+/*
+ * Replies to 'children' ctl command with running children and the
+ * most recently finished ones.
+ */
+void
+list_children()
+{
+	struct child *child;
+	char state[32];
+	size_t i;
+
+	for (child = running_children; child != NULL; child = child->next)
+		reply_child(child, "running", elapsed_ms(&child->start));
+
+	i = nfinished > NUM_FINISHED ? nfinished - NUM_FINISHED : 0;
+	for (; i < nfinished; i++) {
+		child = &finished[i % NUM_FINISHED];
+		if (WIFEXITED(child->status))
+			snprintf(state, sizeof(state), "exit %d",
+			    WEXITSTATUS(child->status));
+		else if (WIFSIGNALED(child->status))
+			snprintf(state, sizeof(state), "signal %d",
+			    WTERMSIG(child->status));
+		else
+			snprintf(state, sizeof(state), "status %d",
+			    child->status);
+		reply_child(child, state, MAX(child->runtime_ms, 0));
+	}
+}
@@ -18,152 +18,18 @@
 
 #include "mxswm.h"
 
-#include <X11/Xutil.h>
-#include <X11/Xatom.h>
 #include <assert.h>
-#include <err.h>
 #include <stdlib.h>
+#include <stdio.h>
 #include <string.h>
 #include <ctype.h>
 
 static struct client *_head;
 static struct client *_focus;
 
-static void	 try_utf8_name(struct client *);
-static void	 try_utf8_renamed_name(struct client *);
-int		 set_utf8_property(Window, Atom, const char *);
-
-int
-set_utf8_property(Window window, Atom atom, const char *text)
-{
-	XTextProperty prop;
-	char *list;
-	int ret;
-
-	list = strdup(text);
-	if (list == NULL)
-		return 0;
-
-	if ((ret = Xutf8TextListToTextProperty(display(), &list, 1,
-	    XUTF8StringStyle, &prop)) == Success)
-		XSetTextProperty(display(), window, &prop, atom);
-
-	free(list);
-
-	return ret;
-}
-
-int
-get_utf8_property(Window window, Atom atom, char **text)
-{
-	XTextProperty prop, prop2;
-	char **list;
-	int nitems = 0;
-
-	*text = NULL;
-
-	XGetTextProperty(display(), window, &prop, atom);
-	if (!prop.nitems) {
-		XFree(prop.value);
-		return 0;
-	}
-
-	if (Xutf8TextPropertyToTextList(display(), &prop, &list,
-	    &nitems) == Success && nitems > 0 && *list) {
-		if (Xutf8TextListToTextProperty(display(), list, nitems,
-		    XUTF8StringStyle, &prop2) == Success) {
-			*text = strdup((const char *) prop2.value);
-			XFree(prop2.value);
-		} else {
-			*text = strdup(*list);
-		}
-		XFreeStringList(list);
-	}
-	XFree(prop.value);
-	return nitems;
-}
-
-static void
-try_utf8_renamed_name(struct client *client)
-{
-	if (client->renamed_name) {
-		free(client->renamed_name);
-		client->renamed_name = NULL;
-	}
-	get_utf8_property(client->window, wmh[_NET_WM_VISIBLE_NAME],
-		&client->renamed_name);
-	if (client->renamed_name != NULL)
-		TRACE_LOG("got renamed name: '%s'", client->renamed_name);
-}
-
-static void
-try_utf8_name(struct client *client)
-{
-	if (client->name) {
-		free(client->name);
-		client->name = NULL;
-	}
-	get_utf8_property(client->window, wmh[_NET_WM_NAME],
-	    &client->name);
-
-	if (client->name != NULL)
-		TRACE_LOG("Got client name: '%s'", client->name);
-}
-
-void
-set_client_name(struct client *client, const char *u8)
-{
-	set_utf8_property(client->window, wmh[_NET_WM_NAME], u8);
-}
-
-void
-rename_client_name(struct client *client, const char *u8)
-{
-	if (client->renamed_name != NULL) {
-		free(client->renamed_name);
-		client->renamed_name = NULL;
-	}
-
-	if (u8 == NULL || u8[0] == '\0' || strcmp(u8, client->name) == 0) {
-		TRACE_LOG("clear NET_WM_VISIBLE_NAME");
-		XDeleteProperty(display(), client->window,
-		    wmh[_NET_WM_VISIBLE_NAME]);
-		try_utf8_name(client);
-		return;
-	}
-
-	TRACE_LOG("set NET_WM_VISIBLE_NAME");
-	if ((client->renamed_name = strdup(u8)) == NULL)
-		warn("strdup");
-	set_utf8_property(client->window, wmh[_NET_WM_VISIBLE_NAME], u8);
-}
-
-void
-update_client_name(struct client *client)
-{
-	XTextProperty text;
-
-	try_utf8_name(client);
-	if (client->name != NULL)
-		return;
-
-	if (XGetWMName(display(), client->window, &text) == 0) {
-		warnx("unable to get name");
-	} else {
-		if (client->name != NULL)
-			free(client->name);
-		client->name = malloc(text.nitems + 1);
-		if (client->name != NULL) {
-			memcpy(client->name, text.value, text.nitems);
-			client->name[text.nitems] = 0;
-		}
-	}
-
-	if (client->name != NULL && client->name[0] == '\0') {
-		free(client->name);
-		client->name = strdup("(no name)");
-	}
-}
+static struct client	*_add_client(Window, struct client *, int,
+			    struct stack *, int);
+static void	 _focus_client(struct client *, struct stack *);
 
 void
 delete_client()
@@ -171,12 +37,9 @@ delete_client()
 	struct client *client;
 
 	client = current_client();
-	if (client == NULL)
+	if (client == NULL || is_replaying())
 		return;
-	if (client->flags & CF_HAS_DELWIN)
-		send_delete_window(client);
-	else
-		XDestroyWindow(display(), client->window);
+	backend->close_client(client);
 }
 
 void
@@ -185,9 +48,9 @@ destroy_client()
 	struct client *client;
 
 	client = current_client();
-	if (client == NULL)
+	if (client == NULL || is_replaying())
 		return;
-	XDestroyWindow(display(), client->window);
+	backend->destroy_window(client->window);
 }
 
 struct client *
@@ -195,7 +58,21 @@ add_client(Window window, struct client *after, int mapped,
     struct stack *stack, int dont_focus)
 {
 	struct client *client;
-	XWindowAttributes a;
+	struct span span;
+
+	metric_begin(METRIC_ADOPT, &span);
+	client = _add_client(window, after, mapped, stack, dont_focus);
+	metric_end(METRIC_ADOPT, &span);
+
+	return client;
+}
+
+static struct client *
+_add_client(Window window, struct client *after, int mapped,
+    struct stack *stack, int dont_focus)
+{
+	struct client *client;
+	int x, y;
 
 	TRACE_LOG("%lx mapped=%d", window, mapped);
 	client = calloc(1, sizeof(struct client));
@@ -210,12 +87,10 @@ add_client(Window window, struct client *after, int mapped,
 	 * default to current stack if problems.
 	 */
 	if (stack == NULL) {
-		if (!XGetWindowAttributes(display(), client->window, &a)) {
-			warnx("XGetWindowAttributes failed for %lx",
-			    client->window);
+		if (!backend->window_position(client->window, &x, &y))
 			stack = current_stack();
-		} else {
-			stack = find_stack_xy(a.x, a.y);
+		else {
+			stack = find_stack_xy(x, y);
 			if (stack == NULL)
 				stack = current_stack();
 		}
@@ -244,12 +119,9 @@ add_client(Window window, struct client *after, int mapped,
 			_head->next->prev = _head;
 	}
 
-	XSelectInput(display(), window, PropertyChangeMask);
+	backend->adopt_client(client);
 
 	if (mapped) {
-		read_protocols(client);
-		update_client_name(client);
-		try_utf8_renamed_name(client);
 		if (!dont_focus)
 			focus_client(client, stack);
 		else
@@ -319,7 +191,7 @@ prev_client(struct client *client, struct stack *stack)
 void
 remove_client(struct client *client)
 {
-	TRACE_LOG("");
+	TRACE_LOG("%lx", client->window);
 	close_menu();
 
 	if (client->next != NULL)
@@ -415,37 +287,30 @@ top_client(struct client *client)
 void
 resize_client(struct client *client)
 {
-	Display *dpy;
 	struct stack *stack;
-	Window window;
-	unsigned long xwcm;
-	XWindowChanges xwc;
-
-	dpy = display();
+	struct span span;
+	int h;
 
 	TRACE_LOG("resize client");
 
 	if (client == NULL)
 		return;
 
+	metric_begin(METRIC_LAYOUT, &span);
+
 	stack = client->stack;
 	if (stack == NULL)
 		stack = current_stack();
 
-	set_font(FONT_TITLE);
+	h = backend->titlebar_height();
 	TRACE_LOG("resize to %dx%d+%d+%d",
 	    STACK_WIDTH(stack), STACK_HEIGHT(stack), STACK_X(stack),
-	    STACK_Y(stack) + get_font_height());
+	    STACK_Y(stack) + h);
 
-	window = client->window;
+	backend->configure_client(client->window, STACK_X(stack),
+	    STACK_Y(stack) + h, STACK_WIDTH(stack), STACK_HEIGHT(stack));
 
-	xwcm = (CWX | CWY | CWWidth | CWHeight | CWBorderWidth);
-	xwc.x = STACK_X(stack);
-	xwc.y = STACK_Y(stack) + get_font_height();
-	xwc.width = STACK_WIDTH(stack);
-	xwc.height = STACK_HEIGHT(stack);
-	xwc.border_width = 0;
-	XConfigureWindow(dpy, window, xwcm, &xwc);
+	metric_end(METRIC_LAYOUT, &span);
 }
 
 size_t
@@ -475,9 +340,16 @@ resize_clients(struct stack *stack)
 void
 focus_client(struct client *client, struct stack *stack)
 {
-	Display *dpy = display();
-	Window window;
+	struct span span;
+
+	metric_begin(METRIC_FOCUS, &span);
+	_focus_client(client, stack);
+	metric_end(METRIC_FOCUS, &span);
+}
 
+static void
+_focus_client(struct client *client, struct stack *stack)
+{
 	if (client == NULL || !client->mapped) {
 		if (client != NULL && client->mapped == 0)
 			TRACE_LOG("tried to focus unmapped client");
@@ -496,19 +368,11 @@ focus_client(struct client *client, struct stack *stack)
 	}
 
 	_focus = client;
-	window = client->window;
-
-	if (client->flags & CF_HAS_TAKEFOCUS) {
-		TRACE_LOG("Sending TAKEFOCUS");
-		send_take_focus(client);
-	} else {
-		TRACE_LOG("Normal input focus");
-		XSetInputFocus(dpy, window, RevertToPointerRoot, CurrentTime);
-	}
+	backend->focus_client(client);
 
 	resize_client(client);
 
-	XRaiseWindow(dpy, window);
+	backend->raise_window(client->window);
 
 	draw_stack(client->stack);
 }
@@ -584,7 +448,7 @@ unmap_clients(struct stack *stack)
 	for (np = _head; np != NULL; np = np->next)
 		if (np->stack == stack && np->mapped) {
 			np->reappear = stack;
-			XUnmapWindow(display(), np->window);
+			backend->unmap_window(np->window);
 		}
 }
 
@@ -596,7 +460,7 @@ map_clients(struct stack *stack)
 	for (np = _head; np != NULL; np = np->next)
 		if (np->reappear == stack && !np->mapped) {
 			np->stack = np->reappear;
-			XMapWindow(display(), np->window);
+			backend->map_window(np->window);
 		}
 }
 
@@ -609,6 +473,43 @@ current_client()
 	return _focus;
 }
 
+/*
+ * Returns the focused client, if any, without focusing one.
+ */
+struct client *
+focused_client()
+{
+	return _focus;
+}
+
+/*
+ * Replies with one JSON object per client, for ctl "list clients".
+ * The stack of an unmapped client is not reported because it may
+ * have been removed meanwhile.
+ */
+void
+list_clients()
+{
+	struct client *np;
+	char name[256], renamed_name[256], stack[32];
+
+	for (np = _head; np != NULL; np = np->next) {
+		snprintf(stack, sizeof(stack), "null");
+		if (np->mapped && np->stack != NULL)
+			snprintf(stack, sizeof(stack), "%d", np->stack->num);
+		ctl_reply("{\"window\":%lu,\"name\":%s,\"renamed_name\":%s,"
+		    "\"stack\":%s,\"mapped\":%s,\"focused\":%s,"
+		    "\"take_focus\":%s,\"delete_window\":%s}\n",
+		    np->window, json_quote(np->name, name, sizeof(name)),
+		    json_quote(np->renamed_name, renamed_name,
+		    sizeof(renamed_name)), stack,
+		    np->mapped ? "true" : "false",
+		    np == _focus ? "true" : "false",
+		    (np->flags & CF_HAS_TAKEFOCUS) ? "true" : "false",
+		    (np->flags & CF_HAS_DELWIN) ? "true" : "false");
+	}
+}
+
 #if (TRACE || TEST)
 #include <inttypes.h>
 #include <stdio.h>
@@ -635,10 +536,15 @@ dump_clients()
 int
 main(int argc, char *argv[])
 {
-	add_client(NULL);
-	add_client(NULL);
-	remove_client(current_client());
-	add_client(current_client());
+	struct stack *stack;
+
+	stack = add_stack(NULL);
+	add_client(1, NULL, 0, stack, 1);
+	add_client(2, NULL, 0, stack, 1);
+	remove_client(have_client(2));
+	add_client(3, have_client(1), 0, stack, 1);
 	dump_clients();
+
+	return 0;
 }
 #endif
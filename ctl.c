@@ -23,6 +23,193 @@
 #include <stdlib.h>
 #include <err.h>
 #include <string.h>
+#include <ctype.h>
+#include <stdarg.h>
+#include <unistd.h>
+
+static ReplyCallback reply_callback;
+static void *reply_udata;
+
+static int segment_number(const char **);
+static int run_status_line(const char *);
+static int run_provider_line(const char *);
+static int run_record_line(const char *);
+static int run_trace_line(const char *);
+static void get_focus(void);
+
+/*
+ * Parses statusbar segment name at the beginning of '*str' and skips
+ * past it. Returns -1 if there is no segment name.
+ */
+static int
+segment_number(const char **str)
+{
+	static const char *segments[NUM_SEGMENT] = {
+		"left", "center", "right"
+	};
+	int segment;
+	size_t len;
+
+	for (segment = 0; segment < NUM_SEGMENT; segment++) {
+		len = strlen(segments[segment]);
+		if (strncmp(*str, segments[segment], len) == 0 &&
+		    ((*str)[len] == '\0' ||
+		    isspace((unsigned char) (*str)[len]))) {
+			*str += len;
+			if (**str != '\0')
+				(*str)++;
+			return segment;
+		}
+	}
+
+	return -1;
+}
+
+/*
+ * Sets where replies to ctl commands go, NULL discards them.
+ */
+void
+set_ctl_reply(ReplyCallback callback, void *udata)
+{
+	reply_callback = callback;
+	reply_udata = udata;
+}
+
+void
+ctl_reply(const char *fmt, ...)
+{
+	va_list ap;
+	char buf[1024], *p;
+	int n;
+
+	if (reply_callback == NULL)
+		return;
+
+	va_start(ap, fmt);
+	n = vsnprintf(buf, sizeof(buf), fmt, ap);
+	va_end(ap);
+	if (n < 0)
+		return;
+	if (n < sizeof(buf)) {
+		reply_callback(buf, n, reply_udata);
+		return;
+	}
+
+	if ((p = malloc(n + 1)) == NULL) {
+		warn("malloc");
+		return;
+	}
+	va_start(ap, fmt);
+	vsnprintf(p, n + 1, fmt, ap);
+	va_end(ap);
+	reply_callback(p, n, reply_udata);
+	free(p);
+}
+
+/*
+ * Returns the length of the valid UTF-8 sequence at 'p', or 0.
+ */
+size_t
+utf8_len(const unsigned char *p)
+{
+	size_t len, i;
+	unsigned char lo, hi;
+
+	lo = 0x80;
+	hi = 0xbf;
+	if (*p < 0x80)
+		return 1;
+	else if (*p >= 0xc2 && *p <= 0xdf)
+		len = 2;
+	else if (*p >= 0xe0 && *p <= 0xef) {
+		len = 3;
+		if (*p == 0xe0)
+			lo = 0xa0;
+		else if (*p == 0xed)
+			hi = 0x9f;
+	} else if (*p >= 0xf0 && *p <= 0xf4) {
+		len = 4;
+		if (*p == 0xf0)
+			lo = 0x90;
+		else if (*p == 0xf4)
+			hi = 0x8f;
+	} else
+		return 0;
+
+	if (p[1] < lo || p[1] > hi)
+		return 0;
+	for (i = 2; i < len; i++)
+		if (p[i] < 0x80 || p[i] > 0xbf)
+			return 0;
+
+	return len;
+}
+
+/*
+ * Quotes 's' as a JSON string into 'buf', or null if 's' is NULL.
+ * Bytes that are not valid UTF-8 become U+FFFD. Truncates at a
+ * character boundary if 'buf' is too small.
+ */
+const char *
+json_quote(const char *s, char *buf, size_t sz)
+{
+	const unsigned char *p;
+	const char *out;
+	size_t n, in, outlen;
+	char esc[8];
+
+	if (s == NULL)
+		return "null";
+
+	n = 0;
+	buf[n++] = '"';
+	for (p = (const unsigned char *) s; *p != '\0'; p += in) {
+		in = 1;
+		out = esc;
+		if (*p == '"' || *p == '\\')
+			outlen = snprintf(esc, sizeof(esc), "\\%c", *p);
+		else if (*p < 0x20)
+			outlen = snprintf(esc, sizeof(esc), "\\u%04x", *p);
+		else if ((in = utf8_len(p)) == 0) {
+			in = 1;
+			outlen = snprintf(esc, sizeof(esc), "\\ufffd");
+		} else {
+			out = (const char *) p;
+			outlen = in;
+		}
+		if (n + outlen + 2 > sz)
+			break;
+		memcpy(&buf[n], out, outlen);
+		n += outlen;
+	}
+	buf[n++] = '"';
+	buf[n] = '\0';
+
+	return buf;
+}
+
+/*
+ * get focus
+ */
+static void
+get_focus()
+{
+	struct client *client;
+	struct stack *stack;
+	char window[32], num[32];
+
+	client = focused_client();
+	stack = focused_stack();
+
+	snprintf(window, sizeof(window), "null");
+	if (client != NULL)
+		snprintf(window, sizeof(window), "%lu", client->window);
+	snprintf(num, sizeof(num), "null");
+	if (stack != NULL)
+		snprintf(num, sizeof(num), "%d", stack->num);
+
+	ctl_reply("{\"window\":%s,\"stack\":%s}\n", window, num);
+}
 
 void
 run_ctl_lines()
@@ -64,31 +251,199 @@ run_ctl_lines()
 	fclose(fp);
 }
 
-void
+/*
+ * status [MONITOR] left|center|right [TEXT]
+ */
+static int
+run_status_line(const char *str)
+{
+	char text[1024];
+	int monitor, segment, n;
+	size_t len;
+
+	monitor = 0;
+	if (sscanf(str, "%d %n", &monitor, &n) == 1) {
+		if (monitor < 1 || monitor > monitors()) {
+			warnx("no such monitor: %d", monitor);
+			return -1;
+		}
+		str += n;
+	}
+
+	if ((segment = segment_number(&str)) == -1) {
+		warnx("unknown statusbar segment: %s", str);
+		return -1;
+	}
+
+	snprintf(text, sizeof(text), "%s", str);
+	for (len = strlen(text); len > 0 && isspace((unsigned char)
+	    text[len - 1]); len--)
+		text[len - 1] = '\0';
+
+	set_statusbar_segment(monitor - 1, segment, text);
+	return 0;
+}
+
+/*
+ * provider NAME [left|center|right]
+ */
+static int
+run_provider_line(const char *str)
+{
+	char name[32];
+	int segment, n;
+
+	if (sscanf(str, "%31s %n", name, &n) != 1) {
+		warnx("provider name missing");
+		return -1;
+	}
+	str += n;
+
+	segment = SEGMENT_RIGHT;
+	if (*str != '\0' && (segment = segment_number(&str)) == -1) {
+		warnx("unknown statusbar segment: %s", str);
+		return -1;
+	}
+
+	return enable_provider(name, segment);
+}
+
+/*
+ * record FILE|stop
+ */
+static int
+run_record_line(const char *str)
+{
+	char path[1024];
+
+	if (sscanf(str, "%1023s", path) != 1) {
+		warnx("record file missing");
+		return -1;
+	}
+
+	if (strcmp(path, "stop") == 0) {
+		stop_recording();
+		return 0;
+	}
+
+	return start_recording(path);
+}
+
+/*
+ * trace [N]
+ * trace json SECONDS FILE
+ * trace snapshot
+ */
+static int
+run_trace_line(const char *str)
+{
+	unsigned long n;
+	char path[1024];
+
+	n = 0;
+	str += strspn(str, " ");
+	if (strncmp(str, "snapshot", strlen("snapshot")) == 0) {
+		trace_dump_snapshot();
+		return 0;
+	}
+	if (strncmp(str, "json ", strlen("json ")) == 0) {
+		if (sscanf(str, "json %lu %1023s", &n, path) != 2) {
+			warnx("trace json needs seconds and file");
+			return -1;
+		}
+		return trace_export(n, path);
+	}
+	if (*str != '\0' && sscanf(str, "%lu", &n) != 1) {
+		warnx("bad number of trace records: %s", str);
+		return -1;
+	}
+
+	trace_dump(n);
+	return 0;
+}
+
+/*
+ * Runs one ctl command. Returns -1 if the command is unknown or fails.
+ */
+int
 run_ctl_line(const char *str)
 {
-	int stackno, width, sticky;
+	int stackno, width, sticky, budget;
 	struct stack *stack;
 
 	TRACE_LOG("\"%s\"", str);
 	if (sscanf(str, "stack %d width %d", &stackno, &width) == 2) {
-		stack = find_stack(stackno);
-		if (stack != NULL)
-			stack->prefer_width = width;
+		if ((stack = find_stack(stackno)) == NULL) {
+			warnx("no such stack: %d", stackno);
+			return -1;
+		}
+		stack->prefer_width = width;
 		resize_stacks();
 		focus_stack(stack);
 	} else if (sscanf(str, "stack %d sticky %d", &stackno, &sticky) == 2) {
-		stack = find_stack(stackno);
-		if (stack != NULL)
-			stack->sticky = sticky ? 1 : 0;
+		if ((stack = find_stack(stackno)) == NULL) {
+			warnx("no such stack: %d", stackno);
+			return -1;
+		}
+		stack->sticky = sticky ? 1 : 0;
 	} else if (strncmp(str, "add stack", strlen("add stack")) == 0) {
 		add_stack(current_stack());
-	}
+	} else if (strncmp(str, "status ", strlen("status ")) == 0) {
+		return run_status_line(str + strlen("status "));
+	} else if (strncmp(str, "provider ", strlen("provider ")) == 0) {
+		return run_provider_line(str + strlen("provider "));
+	} else if (strncmp(str, "barrier", strlen("barrier")) == 0) {
+		if (!is_replaying())
+			sync_events();
+	} else if (strncmp(str, "children", strlen("children")) == 0) {
+		list_children();
+	} else if (strncmp(str, "stats events", strlen("stats events")) == 0) {
+		event_stats();
+	} else if (strncmp(str, "stats errors", strlen("stats errors")) == 0) {
+		xerror_stats();
+	} else if (strncmp(str, "stats latency",
+	    strlen("stats latency")) == 0) {
+		metric_stats();
+	} else if (strncmp(str, "stats requests",
+	    strlen("stats requests")) == 0) {
+		metric_request_stats();
+	} else if (strncmp(str, "stats total", strlen("stats total")) == 0) {
+		metric_total_stats();
+	} else if (strncmp(str, "stats memory",
+	    strlen("stats memory")) == 0) {
+		metric_memory_stats();
+	} else if (strncmp(str, "stats watchdog",
+	    strlen("stats watchdog")) == 0) {
+		watchdog_stats();
+	} else if (sscanf(str, "watchdog %d", &budget) == 1) {
+		if (budget < 0) {
+			warnx("bad watchdog budget: %d", budget);
+			return -1;
+		}
+		set_watchdog_budget(budget);
+	} else if (strncmp(str, "list clients",
+	    strlen("list clients")) == 0) {
+		list_clients();
+	} else if (strncmp(str, "list stacks", strlen("list stacks")) == 0) {
+		list_stacks();
+	} else if (strncmp(str, "get focus", strlen("get focus")) == 0) {
+		get_focus();
+	} else if (strncmp(str, "get layout", strlen("get layout")) == 0) {
+		list_layout();
+	} else if (strncmp(str, "record ", strlen("record ")) == 0) {
+		return run_record_line(str + strlen("record "));
+	} else if (strncmp(str, "trace", strlen("trace")) == 0) {
+		return run_trace_line(str + strlen("trace"));
 #ifdef TRACE
-	if (strncmp(str, "stacks", strlen("stacks")) == 0) {
+	} else if (strncmp(str, "stacks", strlen("stacks")) == 0) {
 		dump_stacks();
 	} else if (strncmp(str, "clients", strlen("clients")) == 0) {
 		dump_clients();
-	}
 #endif
+	} else {
+		warnx("unknown ctl command: %s", str);
+		return -1;
+	}
+
+	return 0;
 }
@@ -22,22 +22,20 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <err.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <sys/stat.h>
 #include <sys/socket.h>
 #include <sys/un.h>
 #include <unistd.h>
 #include <sys/socket.h>
 #include <unistd.h>
-#include <sys/select.h>
 #include <string.h>
-#include <sys/wait.h>
 
 static void process_xevents(void);
-static void process_ctl_client(int);
-static void accept_ctl_client(int);
-
-static int clientfd[128];
-static int nclients;
+static void process_ctl_client(int, void *);
+static void accept_ctl_client(int, void *);
+static void process_xfd(int, void *);
 
 int running;
 
@@ -95,108 +93,350 @@ listen_ctlsocket()
 	return fd;
 }
 
+/*
+ * Commands are framed by newlines, so a client may pipeline many of
+ * them in one write. Each command is acknowledged in order by "ok" or
+ * "err" on a line of its own, after any reply lines of the command.
+ *
+ * Replies are queued and written when the client can take them, so a
+ * slow client never blocks the window manager. No more commands are
+ * run while CTL_OUTPUT_HIGH bytes of replies are unread, and a client
+ * whose queue would exceed CTL_OUTPUT_MAX is dropped.
+ */
+#define CTL_LINE_MAX 4096
+#define CTL_OUTPUT_HIGH (64 * 1024)
+#define CTL_OUTPUT_MAX (4 * 1024 * 1024)
+
+struct ctl_client {
+	int fd;
+	size_t len;
+	int discard;
+	int eof;
+	int failed;
+	char *out;
+	size_t outlen;
+	size_t outsz;
+	char buf[CTL_LINE_MAX];
+};
+
+static void queue_reply(const char *, size_t, void *);
+static void run_ctl_client_line(struct ctl_client *, char *);
+static void run_ctl_client_lines(struct ctl_client *);
+static void close_ctl_client(struct ctl_client *);
+static void service_ctl_client(struct ctl_client *);
+static void write_ctl_client(int, void *);
+
+static void
+queue_reply(const char *buf, size_t n, void *udata)
+{
+	struct ctl_client *cc = udata;
+	size_t sz;
+	char *p;
+
+	if (cc->failed)
+		return;
+	if (cc->outlen + n > CTL_OUTPUT_MAX) {
+		warnx("ctl client does not read replies, dropping it");
+		cc->failed = 1;
+		return;
+	}
+
+	if (cc->outlen + n > cc->outsz) {
+		sz = MAX(cc->outsz * 2, cc->outlen + n);
+		if ((p = realloc(cc->out, sz)) == NULL) {
+			warn("realloc");
+			cc->failed = 1;
+			return;
+		}
+		cc->out = p;
+		cc->outsz = sz;
+	}
+	memcpy(&cc->out[cc->outlen], buf, n);
+	cc->outlen += n;
+}
+
+/*
+ * Runs one command and queues its acknowledgement.
+ */
+static void
+run_ctl_client_line(struct ctl_client *cc, char *line)
+{
+	int ret;
+
+	line[strcspn(line, "\r")] = '\0';
+	set_ctl_reply(queue_reply, cc);
+	record_ctl_line(line);
+	ret = run_ctl_line(line);
+	ctl_reply("%s\n", ret == -1 ? "err" : "ok");
+	set_ctl_reply(NULL, NULL);
+}
+
+/*
+ * Answers a command that cannot be run.
+ */
 static void
-process_ctl_client(int j)
+reject_ctl_client_line(struct ctl_client *cc, const char *why)
+{
+	warnx("ctl command %s", why);
+	queue_reply("err\n", strlen("err\n"), cc);
+}
+
+/*
+ * Runs the command of 'len' bytes at 'line', unless it was too long or
+ * contains a NUL byte.
+ */
+static void
+check_ctl_client_line(struct ctl_client *cc, char *line, size_t len)
+{
+	line[len] = '\0';
+	if (cc->discard) {
+		cc->discard = 0;
+		reject_ctl_client_line(cc, "too long");
+	} else if (memchr(line, '\0', len) != NULL)
+		reject_ctl_client_line(cc, "contains NUL");
+	else
+		run_ctl_client_line(cc, line);
+}
+
+/*
+ * Runs the complete commands in the input buffer until too many replies
+ * are unread.
+ */
+static void
+run_ctl_client_lines(struct ctl_client *cc)
+{
+	char *line, *nl, *end;
+	size_t left;
+
+	line = cc->buf;
+	end = &cc->buf[cc->len];
+	while (!cc->failed && cc->outlen < CTL_OUTPUT_HIGH &&
+	    (nl = memchr(line, '\n', end - line)) != NULL) {
+		check_ctl_client_line(cc, line, nl - line);
+		line = nl + 1;
+	}
+
+	/*
+	 * A full buffer without a newline is the start of a command that
+	 * is too long. The rest of it is skipped up to the next newline.
+	 */
+	left = end - line;
+	if (left == sizeof(cc->buf) - 1 && memchr(line, '\n', left) == NULL) {
+		cc->discard = 1;
+		left = 0;
+	}
+	memmove(cc->buf, line, left);
+	cc->len = left;
+
+	/*
+	 * Run an unterminated last command for clients that just shut
+	 * down their side after writing it.
+	 */
+	if (cc->eof && (cc->len > 0 || cc->discard) && !cc->failed &&
+	    cc->outlen < CTL_OUTPUT_HIGH) {
+		check_ctl_client_line(cc, cc->buf, cc->len);
+		cc->len = 0;
+	}
+}
+
+static void
+close_ctl_client(struct ctl_client *cc)
+{
+	remove_watch(cc->fd);
+	close(cc->fd);
+	free(cc->out);
+	free(cc);
+	TRACE_LOG("remove");
+}
+
+/*
+ * Runs pending commands, writes as many replies as the client takes,
+ * and watches for whatever the client should do next.
+ */
+static void
+service_ctl_client(struct ctl_client *cc)
 {
 	ssize_t n;
-	static char buf[4096];
-	Display *dpy = display();
+	int flags;
 
-	TRACE_LOG("");
-	n = read(clientfd[j], buf, sizeof(buf));
-	if (n == -1 || n == 0) {
-		if (n == -1)
-			warn("read");
-		nclients--;
-		close(clientfd[j]);
-		memmove(&clientfd[j], &clientfd[j+1],
-		    (nclients - j) * sizeof(int));
-		TRACE_LOG("remove\n");
-	} else {
-		buf[n] = '\0';
-		run_ctl_line(buf);
-		TRACE_LOG("flush\n");
-		XFlush(dpy);
+	run_ctl_client_lines(cc);
+
+	flags = 0;
+#ifdef MSG_NOSIGNAL
+	flags = MSG_NOSIGNAL;
+#endif
+	while (!cc->failed && cc->outlen > 0) {
+		n = send(cc->fd, cc->out, cc->outlen, flags);
+		if (n == -1) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+			/*
+			 * A client may go away without reading the
+			 * acknowledgements.
+			 */
+			if (errno != EPIPE && errno != ECONNRESET)
+				warn("ctl reply");
+			cc->failed = 1;
+			break;
+		}
+		memmove(cc->out, &cc->out[n], cc->outlen - n);
+		cc->outlen -= n;
+		if (cc->outlen < CTL_OUTPUT_HIGH &&
+		    (cc->len > 0 || cc->discard))
+			run_ctl_client_lines(cc);
+	}
+
+	if (cc->failed || (cc->eof && cc->len == 0 && cc->outlen == 0)) {
+		close_ctl_client(cc);
+		return;
+	}
+
+	if (modify_watch(cc->fd,
+	    !cc->eof && cc->outlen < CTL_OUTPUT_HIGH ?
+	    process_ctl_client : NULL,
+	    cc->outlen > 0 ? write_ctl_client : NULL) == -1)
+		close_ctl_client(cc);
+}
+
+static void
+process_ctl_client(int fd, void *udata)
+{
+	struct ctl_client *cc = udata;
+	ssize_t n;
+
+	TRACE_LOG("read");
+	n = read(fd, &cc->buf[cc->len], sizeof(cc->buf) - cc->len - 1);
+	if (n == -1) {
+		if (errno == EINTR || errno == EAGAIN)
+			return;
+		warn("read");
+		close_ctl_client(cc);
+		return;
 	}
+	if (n == 0)
+		cc->eof = 1;
+	cc->len += n;
+
+	service_ctl_client(cc);
 }
 
 static void
-accept_ctl_client(int ctlfd)
+write_ctl_client(int fd, void *udata)
 {
+	service_ctl_client(udata);
+}
+
+static void
+accept_ctl_client(int ctlfd, void *udata)
+{
+	struct ctl_client *cc;
 	int fd;
+#ifdef SO_NOSIGPIPE
+	int on = 1;
+#endif
 
-	TRACE_LOG("");
+	TRACE_LOG("accept");
 	fd = accept(ctlfd, NULL, NULL);
-	if (nclients == 128) {
-		warn("maximum ctl clients");
-		close(fd);
-	} else if (fd != -1) {
-		clientfd[nclients++] = fd;
-		TRACE_LOG("add ctl client\n");
-	} else
+	if (fd == -1) {
 		warn("accept");
+		return;
+	}
+
+	if (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) == -1) {
+		warn("fcntl");
+		close(fd);
+		return;
+	}
+#ifdef SO_NOSIGPIPE
+	if (setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on)) == -1)
+		warn("setsockopt SO_NOSIGPIPE");
+#endif
+
+	if ((cc = calloc(1, sizeof(struct ctl_client))) == NULL) {
+		warn("calloc");
+		close(fd);
+		return;
+	}
+	cc->fd = fd;
+	if (add_watch(fd, process_ctl_client, cc) == -1) {
+		free(cc);
+		close(fd);
+		return;
+	}
+	TRACE_LOG("add ctl client");
 }
 
+/*
+ * Events are handled in batches so that superseded events can be
+ * dropped before handling, see handle_events().
+ */
+#define MAX_BATCH 256
+
 static void
 process_xevents()
 {
-	XEvent event;
+	static XEvent batch[MAX_BATCH];
+	size_t n;
 	Display *dpy = display();
 
 	while (XPending(dpy)) {
-		XNextEvent(dpy, &event);
-		handle_event(&event);
+		for (n = 0; n < MAX_BATCH && XPending(dpy); n++)
+			XNextEvent(dpy, &batch[n]);
+
+		record_events(batch, n);
+		handle_events(batch, n);
 	}
-	TRACE_LOG("flush\n");
-	XFlush(dpy);
 }
 
+/*
+ * Handles every event that the X server has sent so far and paints the
+ * result, so that ctl clients can wait for mxswm to catch up with them.
+ */
 void
-run_ctlsocket_event_loop(int ctlfd)
+sync_events()
+{
+	Display *dpy = display();
+
+	XSync(dpy, False);
+	process_xevents();
+	redraw();
+	XSync(dpy, False);
+}
+
+static void
+process_xfd(int fd, void *udata)
+{
+	process_xevents();
+}
+
+/*
+ * Runs the event loop, also accepting ctl clients unless 'ctlfd' is -1.
+ */
+void
+run_event_loop(int ctlfd)
 {
-	fd_set rfds;
-	int nready, i, j;
-	int maxfd;
-	int xfd;
-	int status;
 	Display *dpy;
 
 	dpy = display();
-	xfd = ConnectionNumber(dpy);
-	nclients = 0;
+
+	if (add_watch(ConnectionNumber(dpy), process_xfd, NULL) == -1)
+		errx(1, "cannot watch X connection");
+	if (ctlfd != -1 && add_watch(ctlfd, accept_ctl_client, NULL) == -1)
+		errx(1, "cannot watch ctl socket");
 
 	process_xevents();
 	running = 1;
 	while (running) {
-#ifndef WAIT_MYPGRP
-#define WAIT_MYPGRP 0
-#endif
-		(void) waitpid(WAIT_MYPGRP, &status, WNOHANG);
-
-		FD_ZERO(&rfds);
-		FD_SET(xfd, &rfds);
-		maxfd = xfd;
-		FD_SET(ctlfd, &rfds);
-		if (ctlfd > maxfd)
-			maxfd = ctlfd;
-		for (i = 0; i < nclients; i++) {
-			FD_SET(clientfd[i], &rfds);
-			if (clientfd[i] > maxfd)
-				maxfd = clientfd[i];
-		}
+		/*
+		 * Xlib may have queued events while waiting for a reply,
+		 * in which case the X fd does not become readable.
+		 */
+		if (XEventsQueued(dpy, QueuedAlready) > 0)
+			process_xevents();
+		redraw();
 
-		nready = select(maxfd + 1, &rfds, NULL, NULL, NULL);
-		if (nready == -1 || nready == 0)
-			err(1, "select");
-
-		for (i = 0; i < nready; i++) {
-			if (FD_ISSET(xfd, &rfds))
-				process_xevents();
-			else if (FD_ISSET(ctlfd, &rfds))
-				accept_ctl_client(ctlfd);
-			else for (j = 0; j < nclients; j++)
-				if (FD_ISSET(clientfd[j], &rfds))
-					process_ctl_client(j);
-		}
+		dispatch_watches();
 	}
 }
@@ -25,6 +25,7 @@ static Window window;
 static Time timestamp;
 
 static struct client *client;
+static int event_type;
 
 Time
 current_event_timestamp()
@@ -63,17 +64,26 @@ set_event_client(struct client *_client)
 {
 	client = _client;
 }
+#endif
+
+/*
+ * The type and window of the event being handled, or zeros, for trace
+ * records.
+ */
+int
+current_event_type()
+{
+	return event_type;
+}
 
 Window
 current_window()
 {
 	return window;
 }
-#endif
 
-#ifdef TRACE
 const char *
-str_event(XEvent *event)
+str_event_type(int type)
 {
 	static const struct event_str {
 		int type;
@@ -117,11 +127,8 @@ str_event(XEvent *event)
 	int i;
 	char *s;
 
-	if (event == NULL)
-		return "";
-
 	for (i = 0; es[i].type != -1; i++)
-		if (es[i].type == event->type)
+		if (es[i].type == type)
 			break;
 
 	if (es[i].type != -1)
@@ -131,18 +138,24 @@ str_event(XEvent *event)
 
 	return s;
 }
-#endif
-
-static int disappear_error;
 
-static int
-handle_disappear_error(Display *display, XErrorEvent *event)
+const char *
+str_event(XEvent *event)
 {
-	TRACE_LOG("*");
-	disappear_error = 1;
-	return 1;
+	if (event == NULL)
+		return "";
+
+	return str_event_type(event->type);
 }
 
+static int dispatch_event(XEvent *);
+static void compress_events(XEvent *, size_t);
+
+static unsigned long nevents;
+static unsigned long elided_property;
+static unsigned long elided_expose;
+static unsigned long elided_map;
+
 static void
 pass_configure(XConfigureRequestEvent *event)
 {
@@ -164,45 +177,239 @@ pass_configure(XConfigureRequestEvent *event)
 	XConfigureWindow(dpy, event->window, event->value_mask, &wc); 
 }
 
+/*
+ * Probes sent for windows created but not yet mapped, see
+ * probe_input_only(). Windows become clients only when they ask to be
+ * mapped, and by then the answer has usually arrived.
+ */
+#define NUM_PROBE 64
+
+struct probe {
+	Window window;
+	unsigned long serial;
+};
+
+static struct probe probes[NUM_PROBE];
+static unsigned long nprobes;
+
+/*
+ * Sends a request that fails with BadMatch if the window is InputOnly,
+ * so that the window class can be checked later from the error ring
+ * instead of asking the server right away. Backing planes default to
+ * all ones, so for InputOutput windows the request changes nothing.
+ */
+static void
+probe_input_only(Window window)
+{
+	XSetWindowAttributes a;
+	struct probe *p;
+
+	p = &probes[nprobes++ % NUM_PROBE];
+	p->window = window;
+	p->serial = NextRequest(display());
+	a.backing_planes = AllPlanes;
+	XChangeWindowAttributes(display(), window, CWBackingPlanes, &a);
+}
+
+static struct probe *
+find_probe(Window window)
+{
+	unsigned long i;
+
+	for (i = nprobes; i > 0 && nprobes - i < NUM_PROBE; i--)
+		if (probes[(i - 1) % NUM_PROBE].window == window)
+			return &probes[(i - 1) % NUM_PROBE];
+
+	return NULL;
+}
+
+/*
+ * Returns 1 if 'serial' is a probe, whose BadMatch is expected.
+ */
+int
+is_probe(unsigned long serial)
+{
+	unsigned long i;
+
+	for (i = nprobes; i > 0 && nprobes - i < NUM_PROBE; i--)
+		if (probes[(i - 1) % NUM_PROBE].serial == serial)
+			return 1;
+
+	return 0;
+}
+
+/*
+ * Returns 1 if the window turned out to be InputOnly. 'serial' is the
+ * sequence number of the event being handled.
+ */
 static int
-is_input_only(Window window)
+is_input_only(Window window, unsigned long serial)
 {
 	XWindowAttributes wa;
-	Display *d = display();
-	int input_only;
+	struct probe *p;
+	unsigned long probe;
+
+	/*
+	 * If the server had processed the probe when it generated this
+	 * event, the error, if any, has already been read.
+	 */
+	if ((p = find_probe(window)) != NULL) {
+		probe = p->serial;
+		p->window = 0;
+		if (serial >= probe)
+			return (x_request_error(probe) == BadMatch);
+	}
 
-	input_only = 0;
+	TRACE_LOG("probe not processed yet, asking");
+	if (ROUND_TRIP(XGetWindowAttributes(display(), window, &wa)))
+		return (wa.class == InputOnly);
 
-	XSync(display(), False);
-	XSetErrorHandler(handle_disappear_error);
+	return 0;
+}
 
-	if (XGetWindowAttributes(d, window, &wa)) {
-		input_only = (wa.class == InputOnly);
-		TRACE_LOG("input_only: %d", input_only);
-		return input_only;
+/*
+ * Returns the window an event is about, rather than the window it
+ * was reported to.
+ */
+static Window
+event_window(XEvent *event)
+{
+	switch (event->type) {
+	case MapNotify:
+		return event->xmap.window;
+	case UnmapNotify:
+		return event->xunmap.window;
+	case DestroyNotify:
+		return event->xdestroywindow.window;
+	case CreateNotify:
+		return event->xcreatewindow.window;
+	case ConfigureNotify:
+		return event->xconfigure.window;
+	case ReparentNotify:
+		return event->xreparent.window;
+	case MapRequest:
+		return event->xmaprequest.window;
+	case ConfigureRequest:
+		return event->xconfigurerequest.window;
+	default:
+		return event->xany.window;
 	}
+}
 
-	if (disappear_error) {
-		disappear_error = 0;
-		return 1;
+/*
+ * Drops events from a batch that later events in the same batch make
+ * unnecessary, by setting their type to 0:
+ *
+ *   - PropertyNotify followed by another for the same window and atom,
+ *     because the property is read only when handling the event.
+ *   - Expose with count > 0, because the whole window is painted on
+ *     the last Expose.
+ *   - MapNotify directly followed by UnmapNotify for the same window,
+ *     or the other way around, because they cancel out.
+ */
+static void
+compress_events(XEvent *events, size_t n)
+{
+	XEvent *e, *f;
+	Window w;
+	size_t i, j;
+
+	nevents += n;
+	for (i = 0; i < n; i++) {
+		e = &events[i];
+		switch (e->type) {
+		case Expose:
+			if (e->xexpose.count > 0) {
+				e->type = 0;
+				elided_expose++;
+			}
+			break;
+		case PropertyNotify:
+			for (j = i + 1; j < n; j++) {
+				f = &events[j];
+				if (f->type != PropertyNotify)
+					continue;
+				if (f->xproperty.window ==
+				    e->xproperty.window &&
+				    f->xproperty.atom == e->xproperty.atom) {
+					e->type = 0;
+					elided_property++;
+					break;
+				}
+			}
+			break;
+		case MapNotify:
+		case UnmapNotify:
+			w = event_window(e);
+			for (j = i + 1; j < n; j++) {
+				f = &events[j];
+				if (f->type == 0 || event_window(f) != w)
+					continue;
+				if ((e->type == MapNotify &&
+				    f->type == UnmapNotify) ||
+				    (e->type == UnmapNotify &&
+				    f->type == MapNotify)) {
+					e->type = f->type = 0;
+					elided_map += 2;
+				}
+				break;
+			}
+			break;
+		}
 	}
+}
+
+/*
+ * Handles a batch of events read from the display.
+ */
+void
+handle_events(XEvent *events, size_t n)
+{
+	size_t i;
 
-	XSync(display(), False);
-	XSetErrorHandler(None);
+	compress_events(events, n);
 
-	return 0;
+	for (i = 0; i < n; i++)
+		if (events[i].type != 0)
+			handle_event(&events[i]);
+}
+
+/*
+ * Replies to 'stats events' ctl command.
+ */
+void
+event_stats()
+{
+	ctl_reply("events %lu\n", nevents);
+	ctl_reply("elided property %lu expose %lu map %lu\n",
+	    elided_property, elided_expose, elided_map);
 }
 
 int
 handle_event(XEvent *event)
+{
+	struct span span;
+	int ret;
+
+	metric_begin(event->type, &span);
+	ret = dispatch_event(event);
+	watchdog_event(event, metric_end(event->type, &span));
+
+	return ret;
+}
+
+static int
+dispatch_event(XEvent *event)
 {
 	struct stack *stack;
+	struct probe *probe;
 
 #ifdef TRACE
 	_current_event = event;
 #endif
 	timestamp = CurrentTime;
 	window = 0;
+	event_type = event->type;
 
 	switch (event->type) {
 	case Expose:
@@ -211,7 +418,7 @@ handle_event(XEvent *event)
 		if (stack != NULL)
 			draw_stack(stack);
 		else if (is_statusbar(window))
-			draw_statusbar();
+			expose_statusbar(window);
 		break;
 	case ButtonPress:
 		window = event->xbutton.window;
@@ -229,10 +436,23 @@ handle_event(XEvent *event)
 			TRACE_LOG("ignore");
 		XAllowEvents(display(), ReplayPointer, CurrentTime);
 		break;
-	case KeyRelease:
 	case KeyPress:
 		timestamp = event->xkey.time;
-		do_keyaction(&(event->xkey));
+		if (is_prompt_open())
+			prompt_keypress(&(event->xkey));
+		else
+			do_keyaction(&(event->xkey));
+		break;
+	case KeyRelease:
+		timestamp = event->xkey.time;
+		/*
+		 * Most bindings act on release, so they must not fire
+		 * while typing into the prompt.
+		 */
+		if (is_prompt_open())
+			TRACE_LOG("ignore");
+		else
+			do_keyaction(&(event->xkey));
 		break;
 	case PropertyNotify:
 		window = event->xproperty.window;
@@ -257,21 +477,20 @@ handle_event(XEvent *event)
 					draw_stack(client->stack);
 					draw_menu();
 				} else {
-					TRACE_LOG("unsupported atom %s",
-					    XGetAtomName(display(),
-					    event->xproperty.atom));
+					TRACE_LOG("unsupported atom %lu",
+					    event->xproperty.atom);
 				}
 				break;
 			}
 		} else if (window == DefaultRootWindow(display())) {
 			switch (event->xproperty.atom) {
 			case XA_WM_NAME:
-				draw_statusbar();
+				update_statusbar_name();
 				break;
 			default:
 				if (event->xproperty.atom ==
 				    wmh[_NET_WM_NAME])
-					draw_statusbar();
+					update_statusbar_name();
 				break;
 			}
 		} else
@@ -316,6 +535,9 @@ handle_event(XEvent *event)
 			window = event->xmap.window;
 		else
 			window = event->xdestroywindow.window;
+		if (event->type == DestroyNotify &&
+		    (probe = find_probe(window)) != NULL)
+			probe->window = 0;
 		client = have_client(window);
 		if (client != NULL) {
 			TRACE_LOG("remove");
@@ -331,6 +553,16 @@ handle_event(XEvent *event)
 	case MapRequest:
 		window = event->xmaprequest.window;
 		client = have_client(window);
+		if (client == NULL) {
+			if (is_input_only(window, event->xany.serial)) {
+				TRACE_LOG("ignore InputOnly");
+				break;
+			}
+			client = add_client(window, NULL, 0, current_stack(),
+			    0);
+			if (client == NULL)
+				warn("add_client");
+		}
 		if (client != NULL) {
 			TRACE_LOG("mapping");
 			XMapWindow(display(), window);
@@ -365,8 +597,12 @@ handle_event(XEvent *event)
 			 */
 			if (!client->mapped)
 				pass_configure(&event->xconfigurerequest);
-		} else
-			TRACE_LOG("ignore");
+		} else {
+			/*
+			 * Not mapped yet, see MapRequest.
+			 */
+			pass_configure(&event->xconfigurerequest);
+		}
 		break;
 	case ConfigureNotify:
 		window = event->xconfigure.window;
@@ -381,24 +617,19 @@ handle_event(XEvent *event)
 		    event->xcreatewindow.x, event->xcreatewindow.y,
 		    event->xcreatewindow.border_width,
 		    event->xcreatewindow.override_redirect);
-		if (event->xcreatewindow.override_redirect == True ||
-		    is_input_only(window))
+		if (event->xcreatewindow.override_redirect == True)
 			TRACE_LOG("ignore");
-		else {
-			client = add_client(window, NULL, 0, current_stack(),
-			    0);
-			if (client == NULL)
-				warn("add_client");
-			TRACE_LOG("created");
-		}
+		else
+			probe_input_only(window);
 		break;
 	default:
 		TRACE_LOG("unhandled");
 		break;
 	}
+	event_type = 0;
+	window = 0;
 #ifdef TRACE
 	_current_event = 0;
-	window = 0;
 	client = NULL;
 #endif
 	return 1;
@@ -24,15 +24,41 @@
 #include <limits.h>
 #include <assert.h>
 #include <err.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
 #include "fontnames.c"
+#include "fallbacknames.c"
 
 static XftColor ftcolor;
 static XftFont *ftfont[NUM_FONT];
 static XftFont *current_font;
+static int current_id;
 static XftDraw *ftdraw;
 
+static XftFont *fallback[NUM_FALLBACK];
+static int fallback_tried[NUM_FALLBACK];
+
+/*
+ * Cached answers to "which font draws this codepoint" for each font,
+ * built from the fonts' FcCharSets. An entry is 0 if not yet known,
+ * COVERAGE_SELF if the font itself has the glyph, COVERAGE_NONE if no
+ * font has it and otherwise the index in fallback[] plus COVERAGE_CHAIN.
+ * The codepoint space is split into pages that are allocated on demand.
+ */
+#define COVERAGE_SELF 1
+#define COVERAGE_CHAIN 2
+#define COVERAGE_NONE 255
+#define COVERAGE_PAGE_BITS 8
+#define COVERAGE_PAGES (0x110000 >> COVERAGE_PAGE_BITS)
+
+static unsigned char *coverage[NUM_FONT][COVERAGE_PAGES];
+
 static XftFont *load_font(int);
+static XftFont *fallback_font(int);
+static XftFont *covering_font(FcChar32);
+static size_t text_run(const char *, size_t, XftFont **);
 
 /*
  * Sets font color by reusing named/enum-defined colors from color.c so
@@ -69,20 +95,128 @@ set_font(int id)
 		ftfont[id] = load_font(id);
 
 	current_font = ftfont[id];
+	current_id = id;
+}
+
+static XftFont *
+fallback_font(int i)
+{
+	assert(i < NUM_FALLBACK);
+
+	if (fallback_tried[i])
+		return fallback[i];
+
+	fallback_tried[i] = 1;
+	fallback[i] = XftFontOpenName(display(), DefaultScreen(display()),
+	    fallbackname[i]);
+	if (fallback[i] == NULL)
+		warnx("couldn't load fallback font: %s", fallbackname[i]);
+
+	return fallback[i];
+}
+
+/*
+ * Returns the font that should draw 'ucs' in place of the current font.
+ */
+static XftFont *
+covering_font(FcChar32 ucs)
+{
+	unsigned char **page, *entry;
+	XftFont *font;
+	int i;
+
+	if (ucs >= 0x110000)
+		return current_font;
+
+	page = &coverage[current_id][ucs >> COVERAGE_PAGE_BITS];
+	if (*page == NULL) {
+		*page = calloc(1 << COVERAGE_PAGE_BITS, sizeof(**page));
+		if (*page == NULL)
+			return current_font;
+	}
+	entry = &(*page)[ucs & ((1 << COVERAGE_PAGE_BITS) - 1)];
+
+	if (*entry == 0) {
+		*entry = COVERAGE_NONE;
+		if (FcCharSetHasChar(current_font->charset, ucs))
+			*entry = COVERAGE_SELF;
+		else for (i = 0; i < NUM_FALLBACK; i++) {
+			font = fallback_font(i);
+			if (font != NULL &&
+			    FcCharSetHasChar(font->charset, ucs)) {
+				*entry = COVERAGE_CHAIN + i;
+				break;
+			}
+		}
+	}
+
+	if (*entry == COVERAGE_SELF || *entry == COVERAGE_NONE)
+		return current_font;
+
+	return fallback[*entry - COVERAGE_CHAIN];
+}
+
+/*
+ * Returns the length of the run at the beginning of 'text' that can be
+ * drawn using a single font, and the font in 'font'.
+ */
+static size_t
+text_run(const char *text, size_t len, XftFont **font)
+{
+	XftFont *f;
+	FcChar32 ucs;
+	size_t n;
+	int clen;
+
+	*font = NULL;
+	for (n = 0; n < len; n += clen) {
+		clen = 1;
+		f = current_font;
+		if ((unsigned char) text[n] >= 0x80) {
+			clen = FcUtf8ToUcs4((const FcChar8 *) &text[n], &ucs,
+			    len - n);
+			if (clen > 0)
+				f = covering_font(ucs);
+			else
+				clen = 1;
+		}
+
+		if (*font == NULL)
+			*font = f;
+		else if (f != *font)
+			break;
+	}
+
+	return n;
 }
 
 void
 font_extents(const char *text, size_t len, XGlyphInfo *extents)
 {
-	XftTextExtentsUtf8(display(), current_font,
-	    (const FcChar8 *) text, len, extents);
+	XGlyphInfo run_extents;
+	XftFont *font;
+	size_t n;
+
+	memset(extents, 0, sizeof(*extents));
+	while (len > 0) {
+		n = text_run(text, len, &font);
+		XftTextExtentsUtf8(display(), font, (const FcChar8 *) text, n,
+		    &run_extents);
+		extents->width += run_extents.xOff;
+		extents->xOff += run_extents.xOff;
+		text += n;
+		len -= n;
+	}
+	extents->height = current_font->height;
 }
 
 int
-draw_font(Window window, int x, int y, int bgcolor, const char *text)
+draw_font(Drawable window, int x, int y, int bgcolor, const char *text)
 {
-	XGlyphInfo extents;
-	size_t len;
+	XGlyphInfo extents, run_extents;
+	XftFont *font;
+	size_t len, n;
+	int xoff;
 	XftColor ftbg;
 	XColor xcolor;
 
@@ -112,12 +246,61 @@ draw_font(Window window, int x, int y, int bgcolor, const char *text)
 		    current_font->height);
 	}
 
-	XftDrawStringUtf8(ftdraw, &ftcolor, current_font, x,
-	    y + current_font->ascent, (const FcChar8 *) text, len);
+	xoff = 0;
+	while (len > 0) {
+		n = text_run(text, len, &font);
+		XftTextExtentsUtf8(display(), font, (const FcChar8 *) text, n,
+		    &run_extents);
+		XftDrawStringUtf8(ftdraw, &ftcolor, font, x + xoff,
+		    y + current_font->ascent, (const FcChar8 *) text, n);
+		xoff += run_extents.xOff;
+		text += n;
+		len -= n;
+	}
 
 	return extents.xOff;
 }
 
+/*
+ * Loads all fonts and renders the printable ASCII characters to Xft's
+ * glyph cache so that the first menu, prompt or statusbar draw does not
+ * have to do it on the key press path.
+ */
+void
+warm_fonts()
+{
+	struct timespec start, end;
+	FT_UInt glyphs[0x7f - 0x20];
+	FcChar32 ucs;
+	XftFont *font;
+	int id, i, n, prev_id, nfonts;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	prev_id = current_id;
+	nfonts = 0;
+	for (id = 0; id < NUM_FONT + NUM_FALLBACK; id++) {
+		if (id < NUM_FONT) {
+			set_font(id);
+			font = current_font;
+		} else if ((font = fallback_font(id - NUM_FONT)) == NULL)
+			continue;
+
+		for (n = 0, ucs = 0x20; ucs < 0x7f; ucs++)
+			glyphs[n++] = XftCharIndex(display(), font, ucs);
+		XftFontLoadGlyphs(display(), font, FcTrue, glyphs, n);
+		nfonts++;
+	}
+	if (ftfont[prev_id] != NULL)
+		set_font(prev_id);
+	XSync(display(), False);
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	i = (end.tv_sec - start.tv_sec) * 1000 +
+	    (end.tv_nsec - start.tv_nsec) / 1000000;
+	warnx("warmed up %d fonts in %d ms", nfonts, i);
+}
+
 static XftFont *
 load_font(int id)
 {
@@ -23,6 +23,12 @@
 #include <err.h>
 #include <limits.h>
 
+/*
+ * At most this many commands are kept, the least recently used are
+ * dropped first.
+ */
+#define MAX_COMMAND_HISTORY 1000
+
 static char *command_history_file = ".mxswm_history";
 
 static char **command_history;
@@ -58,6 +64,13 @@ add_command_to_history(const char *s, int reorder)
 		}
 	}
 
+	if (command_history_sz == MAX_COMMAND_HISTORY) {
+		free(command_history[0]);
+		memmove(&command_history[0], &command_history[1],
+		    sizeof(char *) * (command_history_sz - 1));
+		command_history_sz--;
+	}
+
 	if (command_history == NULL ||
 	    command_history_sz == command_history_alloc) {
 		command_history_alloc += 512;
@@ -42,6 +42,8 @@ init_wmh()
 		"_NET_WM_NAME",
 		"_NET_WM_VISIBLE_NAME",
 		"UTF8_STRING",
+		"WM_DELETE_WINDOW",
+		"WM_TAKE_FOCUS",
 	};
 
 	XInternAtoms(display(), atoms, ARRLEN(atoms), False, wmh);
@@ -49,7 +51,14 @@ init_wmh()
 
 #include "mxswm.h"
 
+#include <X11/Xutil.h>
+#include <err.h>
+#include <stdlib.h>
+#include <string.h>
+
 static void send_message(Atom, Window);
+static void try_utf8_name(struct client *);
+static int set_utf8_property(Window, Atom, const char *);
 
 /*
  * Send atom (a) message to a client window (w).
@@ -59,13 +68,11 @@ static void
 send_message(Atom a, Window w)
 {
 	XClientMessageEvent e;
-	Atom wmp;
 
 	e.type = ClientMessage;
 	e.window = w;
 
-	wmp = XInternAtom(display(), "WM_PROTOCOLS", False);
-	e.message_type = wmp;
+	e.message_type = wmh[WM_PROTOCOLS];
 	e.format = 32;
 	e.data.l[0] = a;
 	e.data.l[1] = current_event_timestamp();
@@ -82,10 +89,11 @@ read_protocols(struct client *client)
 
 	TRACE_LOG("reading");
 
-	delwin = XInternAtom(dpy, "WM_DELETE_WINDOW", False);
-	takefocus = XInternAtom(dpy, "WM_TAKE_FOCUS", False);
+	delwin = wmh[WM_DELETE_WINDOW];
+	takefocus = wmh[WM_TAKE_FOCUS];
 
-	if (XGetWMProtocols(dpy, client->window, &protocols, &n)) {
+	if (ROUND_TRIP(XGetWMProtocols(dpy, client->window, &protocols,
+	    &n))) {
 		for (i = 0, ap = protocols; i < n; i++, ap++) {
 			if (*ap == delwin)
 				client->flags |= CF_HAS_DELWIN;
@@ -104,13 +112,143 @@ read_protocols(struct client *client)
 void
 send_delete_window(struct client *client)
 {
-	send_message(XInternAtom(display(), "WM_DELETE_WINDOW", False),
-	    client->window);
+	send_message(wmh[WM_DELETE_WINDOW], client->window);
 }
 
 void
 send_take_focus(struct client *client)
 {
-	send_message(XInternAtom(display(), "WM_TAKE_FOCUS", False),
-	    client->window);
+	send_message(wmh[WM_TAKE_FOCUS], client->window);
+}
+
+static int
+set_utf8_property(Window window, Atom atom, const char *text)
+{
+	XTextProperty prop;
+	char *list;
+	int ret;
+
+	list = strdup(text);
+	if (list == NULL)
+		return 0;
+
+	if ((ret = Xutf8TextListToTextProperty(display(), &list, 1,
+	    XUTF8StringStyle, &prop)) == Success)
+		XSetTextProperty(display(), window, &prop, atom);
+
+	free(list);
+
+	return ret;
+}
+
+int
+get_utf8_property(Window window, Atom atom, char **text)
+{
+	XTextProperty prop, prop2;
+	char **list;
+	int nitems = 0;
+
+	*text = NULL;
+
+	ROUND_TRIP(XGetTextProperty(display(), window, &prop, atom));
+	if (!prop.nitems) {
+		XFree(prop.value);
+		return 0;
+	}
+
+	if (Xutf8TextPropertyToTextList(display(), &prop, &list,
+	    &nitems) == Success && nitems > 0 && *list) {
+		if (Xutf8TextListToTextProperty(display(), list, nitems,
+		    XUTF8StringStyle, &prop2) == Success) {
+			*text = strdup((const char *) prop2.value);
+			XFree(prop2.value);
+		} else {
+			*text = strdup(*list);
+		}
+		XFreeStringList(list);
+	}
+	XFree(prop.value);
+	return nitems;
+}
+
+void
+try_utf8_renamed_name(struct client *client)
+{
+	if (client->renamed_name) {
+		free(client->renamed_name);
+		client->renamed_name = NULL;
+	}
+	get_utf8_property(client->window, wmh[_NET_WM_VISIBLE_NAME],
+		&client->renamed_name);
+	if (client->renamed_name != NULL)
+		TRACE_LOG("got renamed name: '%s'", client->renamed_name);
+}
+
+static void
+try_utf8_name(struct client *client)
+{
+	if (client->name) {
+		free(client->name);
+		client->name = NULL;
+	}
+	get_utf8_property(client->window, wmh[_NET_WM_NAME],
+	    &client->name);
+
+	if (client->name != NULL)
+		TRACE_LOG("Got client name: '%s'", client->name);
+}
+
+void
+set_client_name(struct client *client, const char *u8)
+{
+	set_utf8_property(client->window, wmh[_NET_WM_NAME], u8);
+}
+
+void
+rename_client_name(struct client *client, const char *u8)
+{
+	if (client->renamed_name != NULL) {
+		free(client->renamed_name);
+		client->renamed_name = NULL;
+	}
+
+	if (u8 == NULL || u8[0] == '\0' || strcmp(u8, client->name) == 0) {
+		TRACE_LOG("clear NET_WM_VISIBLE_NAME");
+		XDeleteProperty(display(), client->window,
+		    wmh[_NET_WM_VISIBLE_NAME]);
+		try_utf8_name(client);
+		return;
+	}
+
+	TRACE_LOG("set NET_WM_VISIBLE_NAME");
+	if ((client->renamed_name = strdup(u8)) == NULL)
+		warn("strdup");
+	set_utf8_property(client->window, wmh[_NET_WM_VISIBLE_NAME], u8);
+}
+
+void
+update_client_name(struct client *client)
+{
+	XTextProperty text;
+
+	try_utf8_name(client);
+	if (client->name != NULL)
+		return;
+
+	if (ROUND_TRIP(XGetWMName(display(), client->window, &text)) == 0) {
+		warnx("unable to get name");
+	} else {
+		if (client->name != NULL)
+			free(client->name);
+		client->name = malloc(text.nitems + 1);
+		if (client->name != NULL) {
+			memcpy(client->name, text.value, text.nitems);
+			client->name[text.nitems] = 0;
+		}
+	}
+
+	if (client->name != NULL && client->name[0] == '\0') {
+		free(client->name);
+		client->name = strdup("(no name)");
+	}
 }
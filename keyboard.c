@@ -198,7 +198,10 @@ restart()
 {
 	extern char **Argv;
 
+	if (is_replaying())
+		return;
 	XSync(display(), False);
+	disarm_watchdog();
 	execvp(*Argv, Argv);
 	warn("unable to restart");
 }
@@ -269,7 +272,13 @@ open_menu()
 void
 do_keyaction(XKeyEvent *xkey)
 {
+	struct span span;
+
+	record_keyaction(xkey);
+	key_to_focus_begin();
+	metric_begin(METRIC_KEYACTION, &span);
 	_do_keyaction(xkey, binding, ARRLEN(binding));
+	metric_end(METRIC_KEYACTION, &span);
 }
 
 void
@@ -31,6 +31,10 @@ static int _global_menu_visible;
 static int _highlight;
 static int _use_global_menu;
 
+static int _menu_top;
+static int _menu_rows;
+static int _menu_selected;
+
 static void move_menu_item(int);
 
 static struct client *
@@ -258,6 +262,12 @@ select_next_global_menu()
 
 void
 draw_global_menu()
+{
+	mark_dirty(DIRTY_GLOBAL_MENU);
+}
+
+void
+paint_global_menu()
 {
 	struct client *client;
 	char *name;
@@ -300,21 +310,116 @@ draw_global_menu()
 void
 draw_menu()
 {
-	struct client *client, *cclient;
+	mark_dirty(DIRTY_MENU);
+}
+
+void
+draw_menu_selection()
+{
+	mark_dirty(DIRTY_MENU_SELECTION);
+}
+
+/*
+ * Returns the row of 'client' in the menu of 'stack', or -1. Rows are
+ * the clients after the focused client, the focused one is not listed.
+ */
+static int
+menu_row(struct client *client, struct stack *stack)
+{
+	struct client *np;
+	int row;
+
+	row = 0;
+	np = current_client();
+	while ((np = next_client(np, stack)) != NULL) {
+		if (np == client)
+			return row;
+		row++;
+	}
+
+	return -1;
+}
+
+static struct client *
+menu_row_client(int row, struct stack *stack)
+{
+	struct client *np;
+
+	np = current_client();
+	while ((np = next_client(np, stack)) != NULL && row-- > 0)
+		;
+
+	return np;
+}
+
+static void
+paint_menu_row(struct client *client, struct client *cclient, int row,
+    struct stack *stack)
+{
 	char *name;
+	char buf[256], flags[16];
+	int x, y;
+	XGlyphInfo extents;
+
+	y = (row - _menu_top) * get_font_height();
+
+	if (client->renamed_name != NULL)
+		name = client->renamed_name;
+	else
+		name = client_name(client);
+	if (name == NULL)
+		name = "???";
+
+	snprintf(buf, sizeof(buf), " %s ", name);
+
+	snprintf(flags, sizeof(flags), "%d%c%c%c%c ",
+	    client->stack ? client->stack->num : 0,
+	    (cclient == client) ? '*' : '-',
+	    client->flags & CF_HAS_TAKEFOCUS ? 't' : '-',
+	    client->flags & CF_HAS_DELWIN ? 'd' : '-',
+	    client->mapped ? 'm' : '-');
+
+	if (client == cclient) {
+		if (_highlight)
+			set_font_color(COLOR_MENU_FG_HIGHLIGHT);
+		else
+			set_font_color(COLOR_MENU_FG_FOCUS);
+	} else
+		set_font_color(COLOR_MENU_FG_NORMAL);
+
+	XClearArea(display(), _menu, 0, y, STACK_WIDTH(stack),
+	    get_font_height(), False);
+	x = draw_font(_menu, 0, y, -1, buf);
+
+	set_font_color(COLOR_FLAGS);
+	font_extents(flags, strlen(flags), &extents);
+
+	if (x > STACK_WIDTH(stack) - extents.xOff)
+		x = STACK_WIDTH(stack) - extents.xOff;
+	XClearArea(display(), _menu, x, y, STACK_WIDTH(stack) - x,
+	    get_font_height(), False);
+	draw_font(_menu, STACK_WIDTH(stack) - extents.xOff, y, -1,
+	    flags);
+}
+
+/*
+ * Only as many rows as fit on the stack's monitor are painted. The
+ * visible window of rows is scrolled so that the selected client is
+ * always visible.
+ */
+void
+paint_menu()
+{
+	struct client *client, *cclient;
 	struct stack *stack = current_stack();
-	char buf[256], flags[10];
-	int row_height;
-	int y, x;
+	int row_height, row, maxrows;
 	size_t nclients;
-	XGlyphInfo extents;
 
 	if (_menu_visible == 0 || _menu == 0) {
 		TRACE_LOG("not doing anything...");
 		return;
 	}
 
-	client = NULL;
 	nclients = count_clients(stack);
 	if (nclients > 0)
 		nclients--;
@@ -330,56 +435,62 @@ draw_menu()
 	set_font(FONT_NORMAL);
 	row_height = get_font_height();
 
+	maxrows = MAX(STACK_HEIGHT(stack) / row_height, 1);
+	_menu_rows = MIN(nclients, maxrows);
+
+	_menu_selected = menu_row(cclient, stack);
+	if (_menu_selected >= _menu_top + _menu_rows)
+		_menu_top = _menu_selected - _menu_rows + 1;
+	else if (_menu_selected != -1 && _menu_selected < _menu_top)
+		_menu_top = _menu_selected;
+	if (_menu_top > (int) nclients - _menu_rows)
+		_menu_top = nclients - _menu_rows;
+
 	XMoveResizeWindow(display(), _menu, STACK_X(stack), row_height,
-	    STACK_WIDTH(stack), nclients * row_height);
+	    STACK_WIDTH(stack), _menu_rows * row_height);
 
 	XRaiseWindow(display(), _menu);
 
-	client = current_client();
-	y = 0;
-	while ((client = next_client(client, stack)) != NULL) {
-		if (client->renamed_name != NULL)
-			name = client->renamed_name;
-		else
-			name = client_name(client);
-		if (name == NULL)
-			name = "???";
-
-		snprintf(buf, sizeof(buf), " %s ", name);
-
-		snprintf(flags, sizeof(flags), "%d%c%c%c%c ",
-		    client->stack ? client->stack->num : 0,
-		    (cclient == client) ? '*' : '-',
-		    client->flags & CF_HAS_TAKEFOCUS ? 't' : '-',
-		    client->flags & CF_HAS_DELWIN ? 'd' : '-',
-		    client->mapped ? 'm' : '-');
-
-		if (client == cclient) {
-			if (_highlight)
-				set_font_color(COLOR_MENU_FG_HIGHLIGHT);
-			else
-				set_font_color(COLOR_MENU_FG_FOCUS);
-		} else
-			set_font_color(COLOR_MENU_FG_NORMAL);
-
-		XClearArea(display(), _menu, 0, y, STACK_WIDTH(stack),
-		    get_font_height(), False);
-		x = draw_font(_menu, 0, y, -1, buf);
-
-		set_font_color(COLOR_FLAGS);
-		font_extents(flags, strlen(flags), &extents);
-
-		if (x > STACK_WIDTH(stack) - extents.xOff)
-			x = STACK_WIDTH(stack) - extents.xOff;
-		XClearArea(display(), _menu, x, y, STACK_WIDTH(stack) - x,
-		    get_font_height(), False);
-		draw_font(_menu, STACK_WIDTH(stack) - extents.xOff, y, -1,
-		    flags);
-
-		y += row_height;
+	client = menu_row_client(_menu_top, stack);
+	for (row = _menu_top; client != NULL && row < _menu_top + _menu_rows;
+	    row++) {
+		paint_menu_row(client, cclient, row, stack);
+		client = next_client(client, stack);
 	}
 
-	TRACE_LOG("%zu clients displayed...", nclients);
+	TRACE_LOG("%d/%zu clients displayed...", _menu_rows, nclients);
+}
+
+/*
+ * Repaints only the previously and the newly selected row unless the
+ * selection moved outside of the visible rows.
+ */
+void
+paint_menu_selection()
+{
+	struct client *client, *cclient;
+	struct stack *stack = current_stack();
+	int row;
+
+	if (_menu_visible == 0 || _menu == 0)
+		return;
+
+	cclient = current(stack);
+	row = menu_row(cclient, stack);
+	if (row == -1 || row < _menu_top || row >= _menu_top + _menu_rows) {
+		paint_menu();
+		return;
+	}
+	if (row == _menu_selected)
+		return;
+
+	set_font(FONT_NORMAL);
+	if (_menu_selected >= _menu_top &&
+	    _menu_selected < _menu_top + _menu_rows &&
+	    (client = menu_row_client(_menu_selected, stack)) != NULL)
+		paint_menu_row(client, cclient, _menu_selected, stack);
+	paint_menu_row(cclient, cclient, row, stack);
+	_menu_selected = row;
 }
 
 void
@@ -393,6 +504,7 @@ show_menu()
 		TRACE_LOG("map menu window %lx", _menu);
 		XMapWindow(display(), _menu);
 		_menu_visible = 1;
+		_menu_top = 0;
 		draw_menu();
 		draw_stack(current_stack());
 	} else
@@ -426,7 +538,7 @@ focus_menu_backward()
 		hide_menu();
 		return;
 	}
-	draw_menu();
+	draw_menu_selection();
 }
 
 void
@@ -444,5 +556,5 @@ focus_menu_forward()
 	client = next_client(client, current_stack());
 	if (client != NULL)
 		currentp = client;
-	draw_menu();
+	draw_menu_selection();
 }
@@ -0,0 +1,350 @@
+/*
+ * ISC License
+ *
+ * Copyright (c) 2022, Tommi Leino <namhas@gmail.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * metrics.c:
+ *   Always-on metrics for event handling, key actions and named
+ *   operations such as focusing and layout.
+ *
+ *   Durations are measured with the monotonic clock and counted in
+ *   buckets of powers of two microseconds, so that recording costs two
+ *   clock reads and an increment, and percentiles can be estimated
+ *   within a factor of two.
+ *
+ *   X requests are counted from the display sequence number, and
+ *   round trips by wrapping the blocking calls in ROUND_TRIP().
+ *   Operations may nest, e.g. focusing may relayout, in which case
+ *   the inner operation is counted also in the outer one, but an
+ *   operation nested in itself is counted only once.
+ */
+
+#include "mxswm.h"
+
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || \
+    (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+#include <malloc.h>
+#define HAVE_MALLINFO2
+#endif
+
+#define NUM_BUCKET 32
+
+struct histogram {
+	unsigned long count;
+	unsigned long long max;
+	unsigned long bucket[NUM_BUCKET];
+	unsigned long requests;
+	unsigned long max_requests;
+	unsigned long round_trips;
+	unsigned long max_round_trips;
+	int depth;
+};
+
+static struct histogram histogram[NUM_METRIC];
+static unsigned long round_trips;
+static struct span round_trip_span;
+static struct span key_span;
+static int key_pending;
+static int key_focused;
+
+static unsigned long long now(void);
+static unsigned long long percentile(struct histogram *, int);
+static unsigned long long record_span(int, struct span *);
+
+static unsigned long long
+now()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * ROUND_TRIP() calls these around a call that waits for a reply from
+ * the X server, which is timed as its own metric.
+ */
+void
+round_trip_begin()
+{
+	metric_begin(METRIC_ROUND_TRIP, &round_trip_span);
+	round_trips++;
+}
+
+int
+round_trip_end(int ret)
+{
+	metric_end(METRIC_ROUND_TRIP, &round_trip_span);
+	return ret;
+}
+
+unsigned long
+round_trip_count()
+{
+	return round_trips;
+}
+
+/*
+ * Returns the user and system CPU time used by the process.
+ */
+double
+cpu_time_ms()
+{
+	struct rusage ru;
+
+	if (getrusage(RUSAGE_SELF, &ru) == -1)
+		return 0.0;
+
+	return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000.0 +
+	    (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1000.0;
+}
+
+void
+metric_begin(int metric, struct span *span)
+{
+	if (metric < 0 || metric >= NUM_METRIC)
+		return;
+
+	if (histogram[metric].depth++ > 0)
+		return;
+
+	span->start = now();
+	span->request = backend->next_request();
+	span->round_trips = round_trips;
+}
+
+/*
+ * Records the time elapsed, requests sent and round trips made since
+ * metric_begin(). Returns the time elapsed in nanoseconds, or zero for
+ * a nested operation.
+ */
+unsigned long long
+metric_end(int metric, struct span *span)
+{
+	if (metric < 0 || metric >= NUM_METRIC)
+		return 0;
+
+	if (--histogram[metric].depth > 0)
+		return 0;
+
+	return record_span(metric, span);
+}
+
+/*
+ * Bucket b holds durations of [2^b, 2^(b+1)) us, except that bucket 0
+ * also holds durations under one microsecond.
+ */
+static unsigned long long
+record_span(int metric, struct span *span)
+{
+	struct histogram *h;
+	unsigned long long us, ns;
+	unsigned long n, requests;
+	int b;
+
+	h = &histogram[metric];
+	ns = now() - span->start;
+	us = ns / 1000;
+	for (b = 0; us > 1 && b < NUM_BUCKET - 1; b++)
+		us >>= 1;
+
+	h->bucket[b]++;
+	h->count++;
+	if (ns > h->max)
+		h->max = ns;
+
+	requests = backend->next_request() - span->request;
+	h->requests += requests;
+	if (requests > h->max_requests)
+		h->max_requests = requests;
+
+	n = round_trips - span->round_trips;
+	h->round_trips += n;
+	if (n > h->max_round_trips)
+		h->max_round_trips = n;
+
+	trace_span(metric, span->start, ns, requests, n);
+
+	return ns;
+}
+
+/*
+ * Key-to-focus latency is measured from a key action to the flush of
+ * the focus request it caused, see redraw(). Key actions that do not
+ * move focus are not counted.
+ */
+void
+key_to_focus_begin()
+{
+	key_span.start = now();
+	key_span.request = backend->next_request();
+	key_span.round_trips = round_trips;
+	key_pending = 1;
+	key_focused = 0;
+}
+
+void
+key_to_focus_sent()
+{
+	if (key_pending)
+		key_focused = 1;
+}
+
+void
+key_to_focus_flushed()
+{
+	if (key_pending && key_focused)
+		record_span(METRIC_KEY_TO_FOCUS, &key_span);
+	key_pending = 0;
+}
+
+const char *
+metric_name(int metric)
+{
+	switch (metric) {
+	case METRIC_KEYACTION:
+		return "KeyAction";
+	case METRIC_FOCUS:
+		return "focus";
+	case METRIC_LAYOUT:
+		return "layout";
+	case METRIC_DRAW:
+		return "draw";
+	case METRIC_ADOPT:
+		return "adopt";
+	case METRIC_ROUND_TRIP:
+		return "round trip";
+	case METRIC_KEY_TO_FOCUS:
+		return "key to focus";
+	default:
+		return str_event_type(metric);
+	}
+}
+
+/*
+ * Returns an upper bound for the p'th percentile in microseconds.
+ */
+static unsigned long long
+percentile(struct histogram *h, int p)
+{
+	unsigned long rank, n;
+	unsigned long long max;
+	int b;
+
+	rank = (h->count * p + 99) / 100;
+	max = (h->max + 999) / 1000;
+	for (b = 0, n = 0; b < NUM_BUCKET; b++) {
+		n += h->bucket[b];
+		if (n >= rank)
+			break;
+	}
+	if (b == NUM_BUCKET || (2ULL << b) > max)
+		return max;
+
+	return 2ULL << b;
+}
+
+/*
+ * Replies to 'stats latency' ctl command.
+ */
+void
+metric_stats()
+{
+	struct histogram *h;
+	int i;
+
+	for (i = 0; i < NUM_METRIC; i++) {
+		h = &histogram[i];
+		if (h->count == 0)
+			continue;
+		ctl_reply("%s count %lu p50 %lluus p99 %lluus max %lluus\n",
+		    metric_name(i), h->count, percentile(h, 50),
+		    percentile(h, 99), (h->max + 999) / 1000);
+	}
+}
+
+/*
+ * Replies to 'stats total' ctl command with the totals since startup.
+ */
+void
+metric_total_stats()
+{
+	ctl_reply("requests %lu round_trips %lu cpu_ms %.3f\n",
+	    backend->next_request() - 1, round_trips, cpu_time_ms());
+}
+
+/*
+ * Replies to 'stats memory' ctl command. The resident set size is
+ * read from /proc where there is one, and the heap in use and the free
+ * heap kept by malloc are known only with glibc. Unknown values are
+ * replied as -1.
+ */
+void
+metric_memory_stats()
+{
+	struct rusage ru;
+	FILE *fp;
+	long rss_kb, maxrss_kb, heap_kb, heap_free_kb, pages;
+#ifdef HAVE_MALLINFO2
+	struct mallinfo2 mi;
+#endif
+
+	rss_kb = maxrss_kb = heap_kb = heap_free_kb = -1;
+
+	if ((fp = fopen("/proc/self/statm", "r")) != NULL) {
+		if (fscanf(fp, "%*s %ld", &pages) == 1)
+			rss_kb = pages * (sysconf(_SC_PAGESIZE) / 1024);
+		fclose(fp);
+	}
+	if (getrusage(RUSAGE_SELF, &ru) == 0)
+		maxrss_kb = ru.ru_maxrss;
+#ifdef HAVE_MALLINFO2
+	mi = mallinfo2();
+	heap_kb = mi.uordblks / 1024;
+	heap_free_kb = mi.fordblks / 1024;
+#endif
+
+	ctl_reply("rss_kb %ld maxrss_kb %ld heap_kb %ld heap_free_kb %ld\n",
+	    rss_kb, maxrss_kb, heap_kb, heap_free_kb);
+}
+
+/*
+ * Replies to 'stats requests' ctl command. The maximums are per single
+ * event or operation.
+ */
+void
+metric_request_stats()
+{
+	struct histogram *h;
+	int i;
+
+	for (i = 0; i < NUM_METRIC; i++) {
+		h = &histogram[i];
+		if (h->count == 0)
+			continue;
+		ctl_reply("%s count %lu requests %lu max %lu "
+		    "round_trips %lu max %lu\n", metric_name(i), h->count,
+		    h->requests, h->max_requests, h->round_trips,
+		    h->max_round_trips);
+	}
+}
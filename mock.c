@@ -0,0 +1,307 @@
+/*
+ * ISC License
+ *
+ * Copyright (c) 2021, Tommi Leino <namhas@gmail.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * mock.c:
+ *   A backend that only counts the calls made to it, and microbenchmarks
+ *   of the stack and client model run against it. No X server is
+ *   needed, so the model can be timed with e.g. 100000 clients.
+ */
+
+#include "mxswm.h"
+
+#include <X11/extensions/Xrandr.h>
+#include <err.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+enum mock_op {
+	MOCK_CREATE=0,
+	MOCK_DESTROY,
+	MOCK_MAP,
+	MOCK_UNMAP,
+	MOCK_RAISE,
+	MOCK_MOVE,
+	MOCK_CONFIGURE,
+	MOCK_HIGHLIGHT,
+	MOCK_ADOPT,
+	MOCK_FOCUS,
+	MOCK_CLOSE,
+	MOCK_POSITION,
+	NUM_MOCK_OP
+};
+
+static const char *mock_op_name[NUM_MOCK_OP] = {
+	"create", "destroy", "map", "unmap", "raise", "move", "configure",
+	"highlight", "adopt", "focus", "close", "position"
+};
+
+/*
+ * Titlebar windows are numbered from here so that they do not collide
+ * with the client windows made up by microbench().
+ */
+#define MOCK_FIRST_TITLEBAR 0x40000000
+
+static unsigned long ncalls[NUM_MOCK_OP];
+static unsigned long requests;
+static Window next_titlebar = MOCK_FIRST_TITLEBAR;
+static int nclients;
+
+static Window mock_create_titlebar(void);
+static void mock_destroy_window(Window);
+static void mock_map_window(Window);
+static void mock_unmap_window(Window);
+static void mock_raise_window(Window);
+static void mock_move_titlebar(Window, int, int, int, int);
+static void mock_configure_client(Window, int, int, int, int);
+static void mock_highlight_titlebar(Window, int);
+static void mock_adopt_client(struct client *);
+static void mock_focus_client(struct client *);
+static void mock_close_client(struct client *);
+static int mock_window_position(Window, int *, int *);
+static int mock_titlebar_height(void);
+static unsigned long mock_next_request(void);
+
+static void count(int);
+static unsigned long long now(void);
+static void report(const char *, int, unsigned long long);
+
+const struct backend mock_backend = {
+	"mock",
+	mock_create_titlebar,
+	mock_destroy_window,
+	mock_map_window,
+	mock_unmap_window,
+	mock_raise_window,
+	mock_move_titlebar,
+	mock_configure_client,
+	mock_highlight_titlebar,
+	mock_adopt_client,
+	mock_focus_client,
+	mock_close_client,
+	mock_window_position,
+	mock_titlebar_height,
+	mock_next_request
+};
+
+/*
+ * Each call is counted as one X request would be, so that the request
+ * metrics of the model stay meaningful.
+ */
+static void
+count(int op)
+{
+	ncalls[op]++;
+	requests++;
+}
+
+static Window
+mock_create_titlebar()
+{
+	count(MOCK_CREATE);
+	return next_titlebar++;
+}
+
+static void
+mock_destroy_window(Window window)
+{
+	count(MOCK_DESTROY);
+}
+
+static void
+mock_map_window(Window window)
+{
+	count(MOCK_MAP);
+}
+
+static void
+mock_unmap_window(Window window)
+{
+	count(MOCK_UNMAP);
+}
+
+static void
+mock_raise_window(Window window)
+{
+	count(MOCK_RAISE);
+}
+
+static void
+mock_move_titlebar(Window window, int x, int y, int width, int height)
+{
+	count(MOCK_MOVE);
+}
+
+static void
+mock_configure_client(Window window, int x, int y, int width, int height)
+{
+	count(MOCK_CONFIGURE);
+}
+
+static void
+mock_highlight_titlebar(Window window, int focused)
+{
+	count(MOCK_HIGHLIGHT);
+}
+
+static void
+mock_adopt_client(struct client *client)
+{
+	count(MOCK_ADOPT);
+}
+
+static void
+mock_focus_client(struct client *client)
+{
+	count(MOCK_FOCUS);
+}
+
+static void
+mock_close_client(struct client *client)
+{
+	count(MOCK_CLOSE);
+}
+
+/*
+ * Client positions are unknown, which puts new clients to the current
+ * stack.
+ */
+static int
+mock_window_position(Window window, int *x, int *y)
+{
+	count(MOCK_POSITION);
+	return 0;
+}
+
+static int
+mock_titlebar_height()
+{
+	return 24;
+}
+
+static unsigned long
+mock_next_request()
+{
+	return requests + 1;
+}
+
+static unsigned long long
+now()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Prints one JSON object with the time per operation and the backend
+ * calls made during the phase, and resets the call counters.
+ */
+static void
+report(const char *phase, int ops, unsigned long long start)
+{
+	int i;
+
+	printf("{\"phase\": \"%s\", \"clients\": %d, \"ops\": %d, "
+	    "\"ns_per_op\": %.1f", phase, nclients, ops,
+	    ops > 0 ? (double) (now() - start) / ops : 0.0);
+	for (i = 0; i < NUM_MOCK_OP; i++) {
+		if (ncalls[i] > 0)
+			printf(", \"%s\": %lu", mock_op_name[i], ncalls[i]);
+		ncalls[i] = 0;
+	}
+	printf("}\n");
+	fflush(stdout);
+}
+
+/*
+ * Adds 'n' clients to four stacks on one 1920x1080 monitor, cycles
+ * focus, relayouts, adds and removes stacks and finally removes all
+ * the clients, timing each phase.
+ */
+int
+microbench(int n)
+{
+	extern XRRMonitorInfo *_monitors;
+	extern int _nmonitors;
+	static XRRMonitorInfo monitor;
+	struct stack *stack[4];
+	struct client *client;
+	unsigned long long start;
+	int i, ops;
+
+	if (n < 1) {
+		warnx("microbench: bad number of clients %d", n);
+		return -1;
+	}
+
+	monitor.width = 1920;
+	monitor.height = 1080;
+	_monitors = &monitor;
+	_nmonitors = 1;
+	backend = &mock_backend;
+	nclients = n;
+
+	start = now();
+	stack[0] = add_stack(NULL);
+	for (i = 1; i < ARRLEN(stack); i++)
+		stack[i] = add_stack(stack[i - 1]);
+	report("stacks", ARRLEN(stack), start);
+
+	start = now();
+	for (i = 0; i < n; i++)
+		if (add_client(i + 1, NULL, 1, stack[i % ARRLEN(stack)],
+		    0) == NULL)
+			err(1, "add_client");
+	report("add", n, start);
+
+	ops = 10000;
+	start = now();
+	for (i = 0; i < ops; i++)
+		focus_client_forward();
+	report("focus", ops, start);
+
+	ops = 1000;
+	start = now();
+	for (i = 0; i < ops; i++)
+		focus_stack_forward();
+	report("focus_stack", ops, start);
+
+	ops = 100;
+	start = now();
+	for (i = 0; i < ops; i++)
+		resize_stacks();
+	report("layout", ops, start);
+
+	ops = 100;
+	start = now();
+	for (i = 0; i < ops; i++) {
+		add_stack_here();
+		remove_stack_here();
+	}
+	report("add_remove_stack", ops, start);
+
+	start = now();
+	for (i = 0; (client = next_client(NULL, NULL)) != NULL; i++)
+		remove_client(client);
+	report("remove", i, start);
+
+	return 0;
+}
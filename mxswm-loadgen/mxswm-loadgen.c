@@ -0,0 +1,364 @@
+/*
+ * ISC License
+ *
+ * Copyright (c) 2022, Tommi Leino <namhas@gmail.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * mxswm-loadgen.c:
+ *   Opens a number of lightweight X windows that behave like busy
+ *   clients, for reproducing workloads against mxswm e.g. on Xvfb.
+ *
+ *   The windows change their titles, take part in WM_TAKE_FOCUS, map
+ *   and unmap themselves, ask to be reconfigured and open short-lived
+ *   popups, each at a configurable rate per second over all windows.
+ *   Each action picks a window at random.
+ */
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/Xatom.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <err.h>
+#include <poll.h>
+#include <unistd.h>
+
+#define TICK_MS 10
+#define MAX_POPUP 256
+
+enum action {
+	ACTION_TITLE,
+	ACTION_MAP,
+	ACTION_CONFIGURE,
+	ACTION_POPUP,
+	NUM_ACTION
+};
+
+static const char *action_name[NUM_ACTION] = {
+	"titles", "map/unmap", "configures", "popups"
+};
+
+struct client {
+	Window window;
+	int mapped;
+	unsigned long titles;
+};
+
+struct popup {
+	Window window;
+	double expires;
+};
+
+static Display *dpy;
+static struct client *clients;
+static int nclients;
+static struct popup popups[MAX_POPUP];
+static int npopups;
+
+static Atom wm_protocols, wm_delete_window, wm_take_focus;
+static Atom net_wm_name, utf8_string;
+
+static double rate[NUM_ACTION];
+static unsigned long count[NUM_ACTION];
+static unsigned long take_focus;
+static int popup_ms = 200;
+static int popup_override;
+static int utf8_titles;
+
+static volatile sig_atomic_t running = 1;
+
+static double	 now_ms(void);
+static void	 stop(int);
+static Window	 create_window(int, int, int);
+static void	 open_clients(int, int);
+static void	 set_title(Window, const char *);
+static void	 do_action(int, double);
+static void	 expire_popups(double);
+static void	 handle_event(XEvent *);
+static void	 usage(const char *);
+
+static double
+now_ms()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static void
+stop(int sig)
+{
+	running = 0;
+}
+
+static Window
+create_window(int w, int h, int override)
+{
+	XSetWindowAttributes a;
+
+	a.background_pixel = WhitePixel(dpy, DefaultScreen(dpy));
+	a.override_redirect = override ? True : False;
+	a.event_mask = StructureNotifyMask;
+
+	return XCreateWindow(dpy, DefaultRootWindow(dpy), 0, 0, w, h, 0,
+	    CopyFromParent, InputOutput, CopyFromParent,
+	    CWBackPixel | CWOverrideRedirect | CWEventMask, &a);
+}
+
+/*
+ * Opens 'n' windows, 'percent' of which support WM_TAKE_FOCUS.
+ */
+static void
+open_clients(int n, int percent)
+{
+	Atom protocols[2];
+	char name[64];
+	int i, nprotocols;
+
+	clients = calloc(n, sizeof(struct client));
+	if (clients == NULL)
+		err(1, "calloc");
+
+	for (i = 0; i < n; i++) {
+		clients[i].window = create_window(200, 100, 0);
+
+		nprotocols = 0;
+		protocols[nprotocols++] = wm_delete_window;
+		if (i * 100 < n * percent)
+			protocols[nprotocols++] = wm_take_focus;
+		XSetWMProtocols(dpy, clients[i].window, protocols,
+		    nprotocols);
+
+		snprintf(name, sizeof(name), "loadgen %d", i);
+		set_title(clients[i].window, name);
+
+		XMapWindow(dpy, clients[i].window);
+		clients[i].mapped = 1;
+	}
+	nclients = n;
+}
+
+static void
+set_title(Window window, const char *title)
+{
+	XStoreName(dpy, window, title);
+	if (utf8_titles)
+		XChangeProperty(dpy, window, net_wm_name, utf8_string, 8,
+		    PropModeReplace, (const unsigned char *) title,
+		    strlen(title));
+}
+
+static void
+do_action(int action, double now)
+{
+	struct client *c;
+	struct popup *p;
+	char name[64];
+
+	c = &clients[rand() % nclients];
+	if (c->window == 0)
+		return;
+
+	switch (action) {
+	case ACTION_TITLE:
+		snprintf(name, sizeof(name), "loadgen %lu: %lu",
+		    (unsigned long) (c - clients), ++c->titles);
+		set_title(c->window, name);
+		break;
+	case ACTION_MAP:
+		if (c->mapped)
+			XUnmapWindow(dpy, c->window);
+		else
+			XMapWindow(dpy, c->window);
+		c->mapped = !c->mapped;
+		break;
+	case ACTION_CONFIGURE:
+		XMoveResizeWindow(dpy, c->window, rand() % 100,
+		    rand() % 100, 100 + rand() % 400, 100 + rand() % 400);
+		break;
+	case ACTION_POPUP:
+		if (npopups == MAX_POPUP)
+			return;
+		p = &popups[npopups++];
+		p->window = create_window(150, 50, popup_override);
+		XSetTransientForHint(dpy, p->window, c->window);
+		set_title(p->window, "loadgen popup");
+		XMapWindow(dpy, p->window);
+		p->expires = now + popup_ms;
+		break;
+	}
+	count[action]++;
+}
+
+static void
+expire_popups(double now)
+{
+	int i;
+
+	for (i = 0; i < npopups; ) {
+		if (popups[i].expires <= now) {
+			XDestroyWindow(dpy, popups[i].window);
+			popups[i] = popups[--npopups];
+		} else
+			i++;
+	}
+}
+
+static void
+handle_event(XEvent *e)
+{
+	XClientMessageEvent *cm;
+	int i;
+
+	if (e->type != ClientMessage)
+		return;
+
+	cm = &e->xclient;
+	if (cm->message_type != wm_protocols)
+		return;
+
+	if ((Atom) cm->data.l[0] == wm_take_focus) {
+		XSetInputFocus(dpy, cm->window, RevertToParent,
+		    cm->data.l[1]);
+		take_focus++;
+	} else if ((Atom) cm->data.l[0] == wm_delete_window) {
+		for (i = 0; i < nclients; i++) {
+			if (clients[i].window == cm->window) {
+				XDestroyWindow(dpy, cm->window);
+				clients[i].window = 0;
+			}
+		}
+	}
+}
+
+static void
+usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-ou] [-n windows] [-f percent] "
+	    "[-t titles] [-m maps]\n"
+	    "\t[-c configures] [-p popups] [-l popup_ms] [-d seconds]\n",
+	    prog);
+	exit(1);
+}
+
+int
+main(int argc, char *argv[])
+{
+	struct pollfd pfd;
+	XEvent e;
+	double start, last, now, credit[NUM_ACTION];
+	int ch, i, n, percent, duration;
+
+	n = 100;
+	percent = 0;
+	duration = 0;
+
+	while ((ch = getopt(argc, argv, "c:d:f:l:m:n:op:t:u")) != -1) {
+		switch (ch) {
+		case 'c':
+			rate[ACTION_CONFIGURE] = atof(optarg);
+			break;
+		case 'd':
+			duration = atoi(optarg);
+			break;
+		case 'f':
+			percent = atoi(optarg);
+			break;
+		case 'l':
+			popup_ms = atoi(optarg);
+			break;
+		case 'm':
+			rate[ACTION_MAP] = atof(optarg);
+			break;
+		case 'n':
+			n = atoi(optarg);
+			break;
+		case 'o':
+			popup_override = 1;
+			break;
+		case 'p':
+			rate[ACTION_POPUP] = atof(optarg);
+			break;
+		case 't':
+			rate[ACTION_TITLE] = atof(optarg);
+			break;
+		case 'u':
+			utf8_titles = 1;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (n < 1 || percent < 0 || percent > 100)
+		usage(argv[0]);
+
+	if ((dpy = XOpenDisplay(NULL)) == NULL)
+		errx(1, "cannot open display");
+
+	wm_protocols = XInternAtom(dpy, "WM_PROTOCOLS", False);
+	wm_delete_window = XInternAtom(dpy, "WM_DELETE_WINDOW", False);
+	wm_take_focus = XInternAtom(dpy, "WM_TAKE_FOCUS", False);
+	net_wm_name = XInternAtom(dpy, "_NET_WM_NAME", False);
+	utf8_string = XInternAtom(dpy, "UTF8_STRING", False);
+
+	signal(SIGINT, stop);
+	signal(SIGTERM, stop);
+
+	open_clients(n, percent);
+	XFlush(dpy);
+
+	pfd.fd = ConnectionNumber(dpy);
+	pfd.events = POLLIN;
+	memset(credit, 0, sizeof(credit));
+	start = last = now_ms();
+
+	while (running) {
+		if (XPending(dpy) == 0 && poll(&pfd, 1, TICK_MS) == -1 &&
+		    running)
+			err(1, "poll");
+		while (XPending(dpy)) {
+			XNextEvent(dpy, &e);
+			handle_event(&e);
+		}
+
+		now = now_ms();
+		for (i = 0; i < NUM_ACTION; i++) {
+			credit[i] += rate[i] * (now - last) / 1000.0;
+			for (; credit[i] >= 1.0; credit[i] -= 1.0)
+				do_action(i, now);
+		}
+		last = now;
+
+		expire_popups(now);
+		XFlush(dpy);
+
+		if (duration > 0 && now - start >= duration * 1000.0)
+			break;
+	}
+
+	fprintf(stderr, "%d windows, %.1f s", n, (now_ms() - start) / 1000.0);
+	for (i = 0; i < NUM_ACTION; i++)
+		fprintf(stderr, ", %lu %s", count[i], action_name[i]);
+	fprintf(stderr, ", %lu take focus\n", take_focus);
+
+	XCloseDisplay(dpy);
+	return 0;
+}
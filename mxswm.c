@@ -22,9 +22,9 @@
 #include <err.h>
 #include <stdlib.h>
 #include <locale.h>
+#include <signal.h>
 #include <stdio.h>
 #include <string.h>
-#include <sys/wait.h>
 
 #include <X11/XKBlib.h>
 #include <X11/extensions/XKBrules.h>
@@ -262,30 +262,51 @@ display_height(int monitor)
 int
 main(int argc, char *argv[])
 {
-	int running;
-	XEvent event;
 	Display *dpy;
 	int ctlfd;
-	int status;
 	int i;
+	int want_warm;
+	char *record_file, *replay_file;
 
 	/*
 	 * Store argv so that we can restart the window manager.
 	 */
 	Argv = argv;
 
+	/*
+	 * The watchdog timer is only handled once the event loop is
+	 * about to start, see start_watchdog().
+	 */
+	signal(SIGALRM, SIG_IGN);
+
+	init_trace();
+
 	if (!setlocale(LC_CTYPE, "en_US.UTF-8") || !XSupportsLocale())
 		errx(1, "no locale support");
 
 	mbtowc(NULL, NULL, MB_CUR_MAX);
 
+	if (argc > 1 && strcmp(argv[1], "microbench") == 0)
+		return microbench(argc > 2 ? atoi(argv[2]) : 100000) == 0 ?
+		    0 : 1;
+
 	dpy = display();
 
-	if (argc >= 2)
-		if (strcmp(argv[1], "sync") == 0)
+	want_warm = 0;
+	record_file = replay_file = NULL;
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "sync") == 0)
 			XSynchronize(display(), True);
+		else if (strcmp(argv[i], "warm") == 0)
+			want_warm = 1;
+		else if (strcmp(argv[i], "record") == 0 && i + 1 < argc)
+			record_file = argv[++i];
+		else if (strcmp(argv[i], "replay") == 0 && i + 1 < argc)
+			replay_file = argv[++i];
+	}
 
 	select_root_events(dpy);
+	set_error_handler();
 
 	dump_clients();
 
@@ -293,6 +314,11 @@ main(int argc, char *argv[])
 
 	bind_keys();
 
+	if (want_warm)
+		warm_fonts();
+
+	watch_children();
+
 	add_stack(NULL);
 	for (i = 1; i < _nmonitors; i++)
 		add_stack_to_monitor(last_stack(), i);
@@ -305,25 +331,26 @@ main(int argc, char *argv[])
 
 	focus_stack(find_stack(1));
 
+	if (replay_file != NULL) {
+		redraw();
+		if (replay(replay_file) == -1)
+			return 1;
+		XCloseDisplay(dpy);
+		return 0;
+	}
+
+	if (record_file != NULL && start_recording(record_file) == -1)
+		return 1;
+
+	start_watchdog();
+
 #if WANT_CTLSOCKET
 	ctlfd = listen_ctlsocket();
 #else
 	ctlfd = -1;
 #endif
-	if (ctlfd != -1) {
-		run_ctlsocket_event_loop(ctlfd);
-	} else {
-		running = 1;
-		while (running) {
-#ifndef WAIT_MYPGRP
-#define WAIT_MYPGRP 0
-#endif
-			(void) waitpid(WAIT_MYPGRP, &status, WNOHANG);
-			XNextEvent(dpy, &event);
-			if (handle_event(&event) <= 0)
-				break;
-		}
-	}
+	run_event_loop(ctlfd);
+	stop_recording();
 
 	if (_monitors != NULL)
 		XRRFreeMonitors(_monitors);
@@ -22,16 +22,41 @@
 #include <X11/Xlib.h>
 #include <X11/extensions/Xrender.h>
 
+const char *str_event(XEvent *);
+const char *str_event_type(int);
+int current_event_type(void);
+Window current_window(void);
+
+/*
+ * TRACE_LOG() always records to the trace ring, see trace.c. TRACE
+ * builds also print every record to stderr.
+ */
+void trace_log(const char *, const char *, ...)
+    __attribute__((__format__ (printf, 2, 3)));
+void trace_dump(unsigned long);
+void trace_snapshot(const char *);
+void trace_dump_snapshot(void);
+
+void set_watchdog_budget(int);
+void watchdog_event(XEvent *, unsigned long long);
+void watchdog_idle(int);
+void start_watchdog(void);
+void disarm_watchdog(void);
+void watchdog_stats(void);
+void trace_span(int, unsigned long long, unsigned long long, unsigned long,
+    unsigned long);
+int trace_export(unsigned long, const char *);
+void init_trace(void);
+
 #ifdef TRACE
 #include <stdio.h>
 #include <time.h>
-const char *str_event(XEvent *);
 const char *current_event(void);
-Window current_window(void);
 time_t start_time();
 
 #define TRACE_LOG(...)  \
 	do { \
+		trace_log(__func__, __VA_ARGS__); \
 		fprintf(stderr, "%d %-16s 0x%08lx %-16s %-16s ", \
 		    (int) (time(0) - start_time()), \
 		    current_event(), current_window(), \
@@ -43,7 +68,7 @@ time_t start_time();
 #define TRACE_SET_CLIENT(client) set_event_client(client)
 #define EVENT_STR(event) str_event(event)
 #else
-#define TRACE_LOG(...)   ((void) 0)
+#define TRACE_LOG(...)   trace_log(__func__, __VA_ARGS__)
 #define EVENT_STR(...)   ((void) 0)
 #define TRACE_SET_CLIENT(...)	((void) 0)
 #endif
@@ -65,6 +90,8 @@ enum ewmh {
 	_NET_WM_NAME,
 	_NET_WM_VISIBLE_NAME,
 	UTF8_STRING,
+	WM_DELETE_WINDOW,
+	WM_TAKE_FOCUS,
 	NUM_WMH
 };
 
@@ -73,6 +100,7 @@ extern Atom wmh[NUM_WMH];
 void init_wmh(void);
 
 #include "fontnames.h"
+#include "fallbacknames.h"
 #include "colornames.h"
 
 /*
@@ -106,6 +134,7 @@ struct stack {
 	int sticky;
 	int mapped;
 	int monitor;
+	int dirty;
 };
 
 struct client {
@@ -147,6 +176,9 @@ void focus_stack(struct stack *);
 void focus_stack_forward(void);
 void focus_stack_backward(void);
 struct stack *current_stack(void);
+struct stack *focused_stack(void);
+void list_stacks(void);
+void list_layout(void);
 void resize_stack(struct stack *, unsigned short);
 struct stack *find_stack(int);
 struct stack *find_stack_xy(unsigned short, unsigned short);
@@ -183,6 +215,8 @@ void focus_client_forward(void);
 void focus_client_backward(void);
 void focus_client_cycle_here(void);
 struct client *current_client(void);
+struct client *focused_client(void);
+void list_clients(void);
 struct client *next_client(struct client *, struct stack *);
 struct client *prev_client(struct client *, struct stack *);
 char *client_name(struct client *);
@@ -190,12 +224,44 @@ struct client *find_top_client(struct stack *);
 void unmap_clients(struct stack *);
 void map_clients(struct stack *);
 void update_client_name(struct client *);
+void try_utf8_renamed_name(struct client *);
 void set_client_name(struct client *, const char *);
 void rename_client_name(struct client *, const char *);
 void delete_client(void);
 void destroy_client(void);
 struct client *match_client(const char *);
 
+/*
+ * The window system side of stacks and clients. stack.c and client.c
+ * keep only the model and call these, so that they can be run against
+ * mock_backend without an X server, see microbench().
+ */
+struct backend {
+	const char *name;
+	Window (*create_titlebar)(void);
+	void (*destroy_window)(Window);
+	void (*map_window)(Window);
+	void (*unmap_window)(Window);
+	void (*raise_window)(Window);
+	void (*move_titlebar)(Window, int, int, int, int);
+	void (*configure_client)(Window, int, int, int, int);
+	void (*highlight_titlebar)(Window, int);
+	void (*adopt_client)(struct client *);
+	void (*focus_client)(struct client *);
+	void (*close_client)(struct client *);
+	int (*window_position)(Window, int *, int *);
+	int (*titlebar_height)(void);
+	unsigned long (*next_request)(void);
+};
+
+extern const struct backend *backend;
+extern const struct backend xbackend;
+extern const struct backend mock_backend;
+
+Window create_titlebar(void);
+void paint_titlebar(struct stack *, int);
+int microbench(int);
+
 int monitors(void);
 int monitor(int, int);
 int monitor_x(int);
@@ -204,9 +270,86 @@ unsigned short display_width(int);
 Display *display(void);
 
 int handle_event(XEvent *);
+void set_error_handler(void);
+
+/*
+ * Metrics are kept for each event type, key actions and the named
+ * operations.
+ */
+enum metric {
+	METRIC_KEYACTION = LASTEvent,
+	METRIC_FOCUS,
+	METRIC_LAYOUT,
+	METRIC_DRAW,
+	METRIC_ADOPT,
+	METRIC_ROUND_TRIP,
+	METRIC_KEY_TO_FOCUS,
+	NUM_METRIC
+};
+
+struct span {
+	unsigned long long start;
+	unsigned long request;
+	unsigned long round_trips;
+};
+
+/*
+ * Wraps Xlib calls that wait for a reply from the server.
+ */
+#define ROUND_TRIP(_call) (round_trip_begin(), round_trip_end((_call)))
+
+void round_trip_begin(void);
+int round_trip_end(int);
+unsigned long round_trip_count(void);
+double cpu_time_ms(void);
+void metric_begin(int, struct span *);
+unsigned long long metric_end(int, struct span *);
+void key_to_focus_begin(void);
+void key_to_focus_sent(void);
+void key_to_focus_flushed(void);
+const char *metric_name(int);
+void metric_stats(void);
+void metric_request_stats(void);
+void metric_total_stats(void);
+void metric_memory_stats(void);
+
+int start_recording(const char *);
+void stop_recording(void);
+void record_events(XEvent *, size_t);
+void record_keyaction(XKeyEvent *);
+void record_ctl_line(const char *);
+int replay(const char *);
+int is_replaying(void);
+
+int x_request_error(unsigned long);
+int is_probe(unsigned long);
+void xerror_stats(void);
+void handle_events(XEvent *, size_t);
+void event_stats(void);
+
+/*
+ * Drawing is deferred: draw_*() functions only mark things dirty and
+ * redraw() paints them once the event queue has been drained.
+ */
+#define DIRTY_STACKS (1 << 0)
+#define DIRTY_MENU (1 << 1)
+#define DIRTY_GLOBAL_MENU (1 << 2)
+#define DIRTY_STATUSBAR (1 << 3)
+#define DIRTY_MENU_SELECTION (1 << 4)
+#define DIRTY_PROMPT (1 << 5)
+
+void mark_dirty(int);
+void redraw(void);
+void paint_stacks(void);
+void paint_menu(void);
+void paint_menu_selection(void);
+void paint_global_menu(void);
+void paint_statusbar(void);
+void paint_prompt(void);
 
 void open_menu(void);
 void draw_menu(void);
+void draw_menu_selection(void);
 void close_menu(void);
 
 void draw_global_menu(void);
@@ -232,7 +375,21 @@ int is_menu_visible(void);
 void highlight_menu(int);
 int menu_has_highlight(void);
 
+enum statusbar_segment {
+	SEGMENT_LEFT=0,
+	SEGMENT_CENTER,
+	SEGMENT_RIGHT,
+	NUM_SEGMENT
+};
+
 void draw_statusbar(void);
+void set_statusbar_segment(int, int, const char *);
+void set_statusbar_provider_text(int, const char *);
+
+int enable_provider(const char *, int);
+
+void update_statusbar_name(void);
+void expose_statusbar(Window);
 int is_statusbar(Window);
 void show_statusbar(void);
 void set_statusbar_mapped_status(int);
@@ -251,8 +408,9 @@ void bind_keys();
 void set_font_color(int);
 void set_font(int);
 int get_font_height(void);
-int draw_font(Window, int, int, int, const char *);
+int draw_font(Drawable, int, int, int, const char *);
 void font_extents(const char *, size_t, XGlyphInfo *);
+void warm_fonts(void);
 
 XColor query_color(int);
 
@@ -261,18 +419,39 @@ Time current_event_timestamp(void);
 void prompt_command(void);
 void prompt_rename(void);
 void prompt_find(void);
+int is_prompt_open(void);
+void prompt_keypress(XKeyEvent *);
 
 #ifdef TRACE
 struct client *event_client();
 void set_event_client(struct client *);
 #endif
 
+typedef void (*WatchCallback)(int, void *);
+
+int add_watch(int, WatchCallback, void *);
+int modify_watch(int, WatchCallback, WatchCallback);
+void remove_watch(int);
+void dispatch_watches(void);
+
 #if WANT_CTLSOCKET
 int listen_ctlsocket(void);
-void run_ctlsocket_event_loop(int);
 #endif
-void run_ctl_line(const char *);
+void run_event_loop(int);
+void sync_events(void);
+int run_ctl_line(const char *);
 void run_ctl_lines(void);
+typedef void (*ReplyCallback)(const char *, size_t, void *);
+
+void set_ctl_reply(ReplyCallback, void *);
+void ctl_reply(const char *, ...)
+    __attribute__((__format__ (printf, 1, 2)));
+size_t utf8_len(const unsigned char *);
+const char *json_quote(const char *, char *, size_t);
+
+void watch_children(void);
+pid_t fork_child(const char *);
+void list_children(void);
 
 #if TRACE
 void dump_client(struct client *);
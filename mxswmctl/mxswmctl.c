@@ -20,19 +20,60 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <err.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
 #include <sys/stat.h>
 #include <sys/socket.h>
 #include <sys/un.h>
 #include <unistd.h>
 
+static char reply[4096];
+static size_t replylen;
+static int failed;
+
+/*
+ * Prints the complete reply lines received so far. The "ok" and "err"
+ * acknowledgements are not printed, but "err" makes us fail.
+ */
+static void
+print_replies(int eof)
+{
+	char *line, *nl;
+	size_t left;
+
+	line = reply;
+	while ((nl = memchr(line, '\n', replylen - (line - reply))) != NULL) {
+		*nl = '\0';
+		if (strcmp(line, "err") == 0)
+			failed = 1;
+		else if (strcmp(line, "ok") != 0)
+			printf("%s\n", line);
+		line = nl + 1;
+	}
+
+	left = replylen - (line - reply);
+	if (left > 0 && (eof || left == sizeof(reply))) {
+		fwrite(line, 1, left, stdout);
+		left = 0;
+	}
+	memmove(reply, line, left);
+	replylen = left;
+}
+
 int
 main(int argc, char **argv)
 {
 	char *home;
 	char buf[256] = { 0 };
+	char in[4096];
+	const char *out;
+	size_t outlen;
 	struct stat sb;
+	struct pollfd pfd[2];
+	ssize_t len;
 	int fd;
-	int n;
+	int n, nfds, in_eof, shut;
 	struct sockaddr_un addr;
 
 	if (argc >= 2) {
@@ -41,13 +82,13 @@ main(int argc, char **argv)
 		n = 0;
 		while (argc--) {
 			n += snprintf(&buf[n], sizeof(buf) - n,
-			    "%s ", *argv++);
+			    argc > 0 ? "%s " : "%s\n", *argv++);
 			if (n >= sizeof(buf))
 				errx(1, "argument truncated");
 		}
 	} else {
-		fprintf(stderr, "usage: %s stack NUMBER width NUMBER\n",
-		    argv[0]);
+		fprintf(stderr, "usage: %s stack NUMBER width NUMBER\n"
+		    "       %s - < commands\n", argv[0], argv[0]);
 		return 1;
 	}
 
@@ -75,9 +116,69 @@ main(int argc, char **argv)
 	if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) == -1)
 		err(1, "connect");
 
-	if (write(fd, buf, strlen(buf)) <= 0)
-		err(1, "write");
+	/*
+	 * Given "-", commands are sent from standard input so that many
+	 * of them can be pipelined. Replies are read while sending, or
+	 * both ends could block writing to each other.
+	 */
+	signal(SIGPIPE, SIG_IGN);
+	out = buf;
+	outlen = strlen(buf);
+	in_eof = 1;
+	if (strcmp(buf, "-\n") == 0) {
+		outlen = 0;
+		in_eof = 0;
+	}
+	shut = 0;
+	for (;;) {
+		if (outlen == 0 && in_eof && !shut) {
+			/*
+			 * Tell we are done; the window manager closes
+			 * the connection after the last reply.
+			 */
+			if (shutdown(fd, SHUT_WR) == -1)
+				err(1, "shutdown");
+			shut = 1;
+		}
+
+		pfd[0].fd = fd;
+		pfd[0].events = POLLIN | (outlen > 0 ? POLLOUT : 0);
+		pfd[1].fd = STDIN_FILENO;
+		pfd[1].events = POLLIN;
+		nfds = (!in_eof && outlen == 0) ? 2 : 1;
+		if (poll(pfd, nfds, -1) == -1) {
+			if (errno == EINTR)
+				continue;
+			err(1, "poll");
+		}
+
+		if (pfd[0].revents & POLLOUT) {
+			if ((len = write(fd, out, outlen)) == -1)
+				err(1, "write");
+			out += len;
+			outlen -= len;
+		}
+		if (pfd[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+			len = read(fd, &reply[replylen],
+			    sizeof(reply) - replylen);
+			if (len == -1)
+				err(1, "read");
+			if (len == 0)
+				break;
+			replylen += len;
+			print_replies(0);
+		}
+		if (nfds == 2 && pfd[1].revents != 0) {
+			if ((len = read(STDIN_FILENO, in, sizeof(in))) == -1)
+				err(1, "stdin");
+			if (len == 0)
+				in_eof = 1;
+			out = in;
+			outlen = len;
+		}
+	}
+	print_replies(1);
 
 	close(fd);
-	return 0;
+	return failed;
 }
@@ -15,7 +15,13 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
-/* prompt.c: Implements prompt for running commands. */
+/*
+ * prompt.c:
+ *   Implements prompt for running commands. The prompt does not run
+ *   an event loop of its own: while it is open, key presses are passed
+ *   to it from handle_event() and the rest of the window manager keeps
+ *   running normally.
+ */
 
 #include "mxswm.h"
 
@@ -32,8 +38,9 @@
 typedef void (*PromptCallback)(const char *, void *);
 
 static Window	 create_prompt(void);
+static void	 create_ic(void);
 static void	 draw_prompt(void);
-static void	 close_prompt();
+static void	 close_prompt(void);
 static int	 keycode(XKeyEvent *);
 static void	 open_prompt(const char *, PromptCallback, PromptCallback,
 		    void *, int);
@@ -49,7 +56,10 @@ static wchar_t prompt[4096];
 static size_t nprompt;
 static size_t pos;
 static int _want_centered;
+static int _open;
+static Window rename_window;
 
+static XIM xim;
 static XIC ic;
 
 static PromptCallback callback;
@@ -66,6 +76,10 @@ command_callback(const char *s, void *udata)
 
 	if (s == NULL || strlen(s) == 0)
 		return;
+	if (is_replaying()) {
+		TRACE_LOG("not running '%s' in replay", s);
+		return;
+	}
 
 	q = strdup(s);
 	if (q == NULL) {
@@ -81,10 +95,13 @@ command_callback(const char *s, void *udata)
 	p = malloc(sz);
 	if (p == NULL) {
 		warn("malloc");
+		free(q);
 		return;
 	}
 	if (snprintf(p, sz, "exec %s", q) >= sz) {
 		warnx("truncated '%s'", p);
+		free(p);
+		free(q);
 		return;
 	}
 
@@ -96,7 +113,7 @@ command_callback(const char *s, void *udata)
 		warn("getenv SHELL");
 		sh = "/bin/sh";
 	}
-	pid = fork();
+	pid = fork_child(q);
 	if (pid == 0) {
 #ifndef OPT_SH_FLAGS
 #define OPT_SH_FLAGS "i"
@@ -115,9 +132,11 @@ command_callback(const char *s, void *udata)
 		 * script.
 		 */
 		execl(sh, sh, "-" OPT_SH_FLAGS "c", p, NULL);
-	} else if (pid == -1)
-		warn("fork");
+		warn("%s", sh);
+		_exit(127);
+	}
 
+	free(p);
 	free(q);
 }
 
@@ -142,9 +161,14 @@ command_step_callback(const char *s, void *udata)
 static void
 rename_callback(const char *s, void *udata)
 {
-	struct client *client = udata;
+	struct client *client;
 
-	rename_client_name(client, s);
+	/*
+	 * The client may have disappeared while the prompt was open.
+	 */
+	client = have_client(rename_window);
+	if (client != NULL)
+		rename_client_name(client, s);
 }
 
 static void
@@ -195,17 +219,23 @@ prompt_rename()
 {
 	if (is_menu_visible())
 		select_menu_item();
+	if (current_client() == NULL)
+		return;
+	rename_window = current_client()->window;
 	open_prompt(client_name(current_client()), rename_callback, NULL,
-	    current_client(), 0);
+	    NULL, 0);
+}
+
+int
+is_prompt_open()
+{
+	return _open;
 }
 
 static void
 open_prompt(const char *initial, PromptCallback _callback,
     PromptCallback _step_callback, void *udata, int center)
 {
-	XEvent e;
-	XIM xim;
-
 	callback = _callback;
 	callback_udata = udata;
 
@@ -223,8 +253,10 @@ open_prompt(const char *initial, PromptCallback _callback,
 		prompt[nprompt] = '\0';
 	}
 
-	if (window == 0)
+	if (window == 0) {
 		window = create_prompt();
+		create_ic();
+	}
 
 	set_font(FONT_TITLE);
 
@@ -236,47 +268,51 @@ open_prompt(const char *initial, PromptCallback _callback,
 		XMoveResizeWindow(display(), window, STACK_X(current_stack()),
 		    STACK_Y(current_stack()), STACK_WIDTH(current_stack()),
 		    get_font_height());
+
 	XRaiseWindow(display(), window);
 	XMapWindow(display(), window);
-	draw_prompt();
-
-	XSync(display(), False);
-	XGrabKeyboard(display(), window, True, GrabModeAsync, GrabModeAsync,
-	    CurrentTime);
-
-	xim = XOpenIM(display(), NULL, NULL, NULL);
-
-	ic = XCreateIC(xim, XNInputStyle, XIMPreeditNothing | XIMStatusNothing,
-	    XNClientWindow, window, NULL);
-	XSetICFocus(ic);
-
-	for (;;) {
-		XWindowEvent(display(), window, KeyPressMask, &e);
-
-		switch (e.type) {
-		case KeyPress:
-			if (keycode(&e.xkey) == 0)
-				goto out;
-			draw_prompt();
-			break;
-		default:
-			break;
-		}
-	}
 
-	XUnsetICFocus(ic);
-	XDestroyIC(ic);
-
-out:
-	close_prompt();
+	/*
+	 * No need to sync before grabbing: the server handles the
+	 * requests in order, so the window is viewable by the time the
+	 * grab is processed.
+	 */
+	ROUND_TRIP(XGrabKeyboard(display(), window, True, GrabModeAsync,
+	    GrabModeAsync, CurrentTime));
+	if (ic != NULL)
+		XSetICFocus(ic);
+
+	_open = 1;
+	mark_dirty(DIRTY_PROMPT);
 }
 
-void
+static void
 close_prompt()
 {
+	if (ic != NULL)
+		XUnsetICFocus(ic);
 	XUngrabKeyboard(display(), CurrentTime);
 	XUnmapWindow(display(), window);
-	XFlush(display());
+	_open = 0;
+}
+
+/*
+ * Handles a key press while the prompt is open.
+ */
+void
+prompt_keypress(XKeyEvent *e)
+{
+	if (keycode(e) == 0)
+		close_prompt();
+	else
+		mark_dirty(DIRTY_PROMPT);
+}
+
+void
+paint_prompt()
+{
+	if (_open)
+		draw_prompt();
 }
 
 static int
@@ -312,7 +348,11 @@ keycode(XKeyEvent *e)
 			return 1;
 	}
 
-	if ((n = Xutf8LookupString(ic, e, ch, sizeof(ch), &sym, NULL)) < 0) {
+	if (ic == NULL)
+		n = XLookupString(e, ch, sizeof(ch), &sym, NULL);
+	else
+		n = Xutf8LookupString(ic, e, ch, sizeof(ch), &sym, NULL);
+	if (n < 0) {
 		TRACE_LOG("XLookupString failed");
 		n = 0;
 		return 1;
@@ -362,6 +402,25 @@ create_prompt()
 	return window;
 }
 
+/*
+ * The input method and context are created once and reused each
+ * time the prompt is opened.
+ */
+static void
+create_ic()
+{
+	xim = XOpenIM(display(), NULL, NULL, NULL);
+	if (xim == NULL) {
+		warnx("XOpenIM failed");
+		return;
+	}
+
+	ic = XCreateIC(xim, XNInputStyle, XIMPreeditNothing | XIMStatusNothing,
+	    XNClientWindow, window, NULL);
+	if (ic == NULL)
+		warnx("XCreateIC failed");
+}
+
 static void
 draw_prompt()
 {
@@ -0,0 +1,294 @@
+/*
+ * ISC License
+ *
+ * Copyright (c) 2022, Tommi Leino <namhas@gmail.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * provider.c:
+ *   Implements built-in statusbar providers for clock, load average,
+ *   memory, CPU usage and battery so that no external status program
+ *   needs to be run.
+ *
+ *   All providers are driven by a single timerfd(2) that expires at
+ *   every full second of wall clock time, so that they all wake up
+ *   together. A provider with a longer interval runs only when the
+ *   current time is divisible by it. The statusbar segment is set only
+ *   if the resulting text changed.
+ */
+
+#include "mxswm.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <err.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/timerfd.h>
+#endif
+
+struct provider {
+	const char *name;
+	int interval;
+	int (*read)(char *, size_t);
+	int segment;
+	int enabled;
+	char text[64];
+};
+
+#ifdef __linux__
+static int read_clock(char *, size_t);
+static int read_load(char *, size_t);
+static int read_memory(char *, size_t);
+static int read_cpu(char *, size_t);
+static int read_battery(char *, size_t);
+
+static struct provider providers[] = {
+	{ "load", 5, read_load },
+	{ "cpu", 2, read_cpu },
+	{ "memory", 5, read_memory },
+	{ "battery", 30, read_battery },
+	{ "clock", 1, read_clock },
+};
+
+static int timerfd = -1;
+
+static void run_providers(int, void *);
+
+static int
+read_clock(char *buf, size_t sz)
+{
+	time_t t;
+
+	t = time(NULL);
+	return strftime(buf, sz, "%a %d %b %H:%M", localtime(&t)) > 0;
+}
+
+static int
+read_load(char *buf, size_t sz)
+{
+	FILE *fp;
+	double load;
+	int n;
+
+	if ((fp = fopen("/proc/loadavg", "r")) == NULL)
+		return 0;
+	n = fscanf(fp, "%lf", &load);
+	fclose(fp);
+	if (n != 1)
+		return 0;
+
+	snprintf(buf, sz, "load %.2f", load);
+	return 1;
+}
+
+static int
+read_memory(char *buf, size_t sz)
+{
+	FILE *fp;
+	char line[256];
+	unsigned long total, avail;
+
+	if ((fp = fopen("/proc/meminfo", "r")) == NULL)
+		return 0;
+	total = avail = 0;
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		if (sscanf(line, "MemTotal: %lu", &total) == 1)
+			continue;
+		if (sscanf(line, "MemAvailable: %lu", &avail) == 1)
+			break;
+	}
+	fclose(fp);
+	if (total == 0)
+		return 0;
+
+	snprintf(buf, sz, "mem %lu%%", (total - avail) * 100 / total);
+	return 1;
+}
+
+static int
+read_cpu(char *buf, size_t sz)
+{
+	static unsigned long long prev_total, prev_idle;
+	unsigned long long v[8], total, idle, dt;
+	FILE *fp;
+	int i, n;
+
+	if ((fp = fopen("/proc/stat", "r")) == NULL)
+		return 0;
+	memset(v, 0, sizeof(v));
+	n = fscanf(fp, "cpu %llu %llu %llu %llu %llu %llu %llu %llu",
+	    &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6], &v[7]);
+	fclose(fp);
+	if (n < 4)
+		return 0;
+
+	for (total = 0, i = 0; i < 8; i++)
+		total += v[i];
+	idle = v[3] + v[4];
+
+	dt = total - prev_total;
+	if (prev_total == 0 || dt == 0) {
+		prev_total = total;
+		prev_idle = idle;
+		return 0;
+	}
+
+	snprintf(buf, sz, "cpu %llu%%",
+	    100 - (idle - prev_idle) * 100 / dt);
+	prev_total = total;
+	prev_idle = idle;
+	return 1;
+}
+
+static int
+read_battery(char *buf, size_t sz)
+{
+	FILE *fp;
+	char status[32];
+	int capacity, n;
+
+	if ((fp = fopen("/sys/class/power_supply/BAT0/capacity", "r")) ==
+	    NULL)
+		return 0;
+	n = fscanf(fp, "%d", &capacity);
+	fclose(fp);
+	if (n != 1)
+		return 0;
+
+	status[0] = '\0';
+	if ((fp = fopen("/sys/class/power_supply/BAT0/status", "r")) !=
+	    NULL) {
+		if (fgets(status, sizeof(status), fp) == NULL)
+			status[0] = '\0';
+		fclose(fp);
+	}
+
+	snprintf(buf, sz, "bat %d%%%s", capacity,
+	    strncmp(status, "Charging", strlen("Charging")) == 0 ? "+" : "");
+	return 1;
+}
+
+/*
+ * Joins the texts of the enabled providers of each segment and passes
+ * them on to the statusbar, which ignores unchanged text.
+ */
+static void
+update_segments(time_t now, int force)
+{
+	struct provider *p;
+	char buf[NUM_SEGMENT][512];
+	size_t n[NUM_SEGMENT];
+	int i;
+
+	memset(n, 0, sizeof(n));
+	for (i = 0; i < ARRLEN(providers); i++) {
+		p = &providers[i];
+		if (!p->enabled)
+			continue;
+		if (force || now % p->interval == 0)
+			if (!p->read(p->text, sizeof(p->text)))
+				p->text[0] = '\0';
+		if (p->text[0] == '\0' || n[p->segment] >=
+		    sizeof(buf[p->segment]))
+			continue;
+		n[p->segment] += snprintf(&buf[p->segment][n[p->segment]],
+		    sizeof(buf[p->segment]) - n[p->segment], "%s%s",
+		    n[p->segment] > 0 ? " | " : "", p->text);
+	}
+
+	/*
+	 * Segments without providers are cleared too, in case one was
+	 * moved elsewhere.
+	 */
+	for (i = 0; i < NUM_SEGMENT; i++)
+		set_statusbar_provider_text(i, n[i] > 0 ? buf[i] : NULL);
+}
+
+static int
+start_timer()
+{
+	struct itimerspec its;
+
+	if (timerfd != -1)
+		return 0;
+
+	timerfd = timerfd_create(CLOCK_REALTIME, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (timerfd == -1) {
+		warn("timerfd_create");
+		return -1;
+	}
+
+	/*
+	 * Expire at the next full second and every second after that.
+	 */
+	memset(&its, 0, sizeof(its));
+	its.it_value.tv_sec = time(NULL) + 1;
+	its.it_interval.tv_sec = 1;
+	if (timerfd_settime(timerfd, TFD_TIMER_ABSTIME, &its, NULL) == -1 ||
+	    add_watch(timerfd, run_providers, NULL) == -1) {
+		warn("timerfd");
+		close(timerfd);
+		timerfd = -1;
+		return -1;
+	}
+
+	return 0;
+}
+
+int
+enable_provider(const char *name, int segment)
+{
+	int i;
+
+	for (i = 0; i < ARRLEN(providers); i++)
+		if (strcmp(providers[i].name, name) == 0)
+			break;
+	if (i == ARRLEN(providers)) {
+		warnx("unknown provider: %s", name);
+		return -1;
+	}
+
+	if (start_timer() == -1)
+		return -1;
+
+	providers[i].segment = segment;
+	providers[i].enabled = 1;
+	update_segments(time(NULL), 1);
+	return 0;
+}
+
+static void
+run_providers(int fd, void *udata)
+{
+	uint64_t expirations;
+
+	if (read(fd, &expirations, sizeof(expirations)) == -1)
+		return;
+
+	update_segments(time(NULL), 0);
+}
+#else
+int
+enable_provider(const char *name, int segment)
+{
+	warnx("statusbar providers are not supported on this system");
+	return -1;
+}
+#endif
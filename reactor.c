@@ -0,0 +1,257 @@
+/*
+ * ISC License
+ *
+ * Copyright (c) 2022, Tommi Leino <namhas@gmail.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * reactor.c:
+ *   Watches file descriptors for input, and optionally for output,
+ *   and calls their callbacks.
+ *
+ *   Descriptors are registered once. On Linux, epoll(7) is used so
+ *   that dispatching costs only as much as there are ready descriptors;
+ *   elsewhere poll(2) is used.
+ */
+
+#include "mxswm.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <err.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#else
+#include <poll.h>
+#endif
+
+struct watch {
+	int fd;
+	WatchCallback callback;
+	WatchCallback output;
+	void *udata;
+	struct watch *next_dead;
+};
+
+/*
+ * Watches indexed by fd. Removed watches are freed only after the
+ * current dispatch round, because an event for them may still be
+ * pending in the same round.
+ */
+static struct watch **watches;
+static int nwatches;
+static struct watch *dead;
+
+#ifdef __linux__
+static int epfd = -1;
+#else
+static struct pollfd *pfds;
+static struct watch **pwatches;
+#endif
+
+int
+add_watch(int fd, WatchCallback callback, void *udata)
+{
+	struct watch **p, *w;
+	int n;
+#ifdef __linux__
+	struct epoll_event ev;
+
+	if (epfd == -1 && (epfd = epoll_create1(EPOLL_CLOEXEC)) == -1) {
+		warn("epoll_create1");
+		return -1;
+	}
+#endif
+
+	if (fd >= nwatches) {
+		n = MAX(fd + 1, nwatches * 2);
+		p = realloc(watches, n * sizeof(struct watch *));
+		if (p == NULL) {
+			warn("realloc");
+			return -1;
+		}
+		memset(&p[nwatches], 0, (n - nwatches) * sizeof(*p));
+		watches = p;
+		nwatches = n;
+	}
+
+	if ((w = calloc(1, sizeof(struct watch))) == NULL) {
+		warn("calloc");
+		return -1;
+	}
+	w->fd = fd;
+	w->callback = callback;
+	w->udata = udata;
+
+#ifdef __linux__
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.ptr = w;
+	if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+		warn("epoll_ctl");
+		free(w);
+		return -1;
+	}
+#endif
+	watches[fd] = w;
+
+	return 0;
+}
+
+void
+remove_watch(int fd)
+{
+	struct watch *w;
+
+	if (fd < 0 || fd >= nwatches || (w = watches[fd]) == NULL)
+		return;
+
+#ifdef __linux__
+	if (epoll_ctl(epfd, EPOLL_CTL_DEL, fd, NULL) == -1)
+		warn("epoll_ctl");
+#endif
+	watches[fd] = NULL;
+	w->fd = -1;
+	w->next_dead = dead;
+	dead = w;
+}
+
+/*
+ * Sets the callbacks for when 'fd' is readable and when it is writable.
+ * NULL stops watching for that condition.
+ */
+int
+modify_watch(int fd, WatchCallback input, WatchCallback output)
+{
+	struct watch *w;
+#ifdef __linux__
+	struct epoll_event ev;
+#endif
+
+	if (fd < 0 || fd >= nwatches || (w = watches[fd]) == NULL)
+		return -1;
+
+#ifdef __linux__
+	memset(&ev, 0, sizeof(ev));
+	ev.events = (input != NULL ? EPOLLIN : 0) |
+	    (output != NULL ? EPOLLOUT : 0);
+	ev.data.ptr = w;
+	if (epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev) == -1) {
+		warn("epoll_ctl");
+		return -1;
+	}
+#endif
+	w->callback = input;
+	w->output = output;
+
+	return 0;
+}
+
+static void
+free_dead_watches()
+{
+	struct watch *w;
+
+	while ((w = dead) != NULL) {
+		dead = w->next_dead;
+		free(w);
+	}
+}
+
+#ifdef __linux__
+void
+dispatch_watches()
+{
+	struct epoll_event ev[32];
+	struct watch *w;
+	int i, n;
+
+	watchdog_idle(1);
+	n = epoll_wait(epfd, ev, ARRLEN(ev), -1);
+	watchdog_idle(0);
+	if (n == -1) {
+		if (errno == EINTR)
+			return;
+		err(1, "epoll_wait");
+	}
+
+	for (i = 0; i < n; i++) {
+		w = ev[i].data.ptr;
+		if (w->fd != -1 && w->callback != NULL &&
+		    (ev[i].events & ~EPOLLOUT))
+			w->callback(w->fd, w->udata);
+		if (w->fd != -1 && w->output != NULL &&
+		    (ev[i].events & (EPOLLOUT | EPOLLERR | EPOLLHUP)))
+			w->output(w->fd, w->udata);
+	}
+
+	free_dead_watches();
+}
+#else
+void
+dispatch_watches()
+{
+	struct pollfd *p;
+	struct watch **q, *w;
+	int i, n, nfds;
+
+	p = realloc(pfds, nwatches * sizeof(struct pollfd));
+	q = realloc(pwatches, nwatches * sizeof(struct watch *));
+	if (p != NULL)
+		pfds = p;
+	if (q != NULL)
+		pwatches = q;
+	if (p == NULL || q == NULL)
+		err(1, "realloc");
+
+	for (nfds = 0, i = 0; i < nwatches; i++) {
+		if (watches[i] == NULL)
+			continue;
+		pfds[nfds].fd = i;
+		pfds[nfds].events =
+		    (watches[i]->callback != NULL ? POLLIN : 0) |
+		    (watches[i]->output != NULL ? POLLOUT : 0);
+		pfds[nfds].revents = 0;
+		pwatches[nfds++] = watches[i];
+	}
+
+	watchdog_idle(1);
+	n = poll(pfds, nfds, -1);
+	watchdog_idle(0);
+	if (n == -1) {
+		if (errno == EINTR)
+			return;
+		err(1, "poll");
+	}
+
+	for (i = 0; i < nfds && n > 0; i++) {
+		if (pfds[i].revents == 0)
+			continue;
+		n--;
+		w = pwatches[i];
+		if (w->fd != -1 && w->callback != NULL &&
+		    (pfds[i].revents & ~POLLOUT))
+			w->callback(w->fd, w->udata);
+		if (w->fd != -1 && w->output != NULL &&
+		    (pfds[i].revents & (POLLOUT | POLLERR | POLLHUP)))
+			w->output(w->fd, w->udata);
+	}
+
+	free_dead_watches();
+}
+#endif
@@ -0,0 +1,362 @@
+/*
+ * ISC License
+ *
+ * Copyright (c) 2022, Tommi Leino <namhas@gmail.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * record.c:
+ *   Records X events, key actions and ctl lines to a binary log, and
+ *   replays such a log through the normal event handling so that
+ *   performance can be compared across builds.
+ *
+ *   The log starts with a header, followed by records which each have
+ *   a type, payload length and the time since the recording started.
+ *   X events are recorded in the batches they were read in, each event
+ *   only as large as its type needs.
+ *
+ *   Key actions are recorded for reference only: they are caused by
+ *   the recorded key events, so on replay they are just counted.
+ */
+
+#include "mxswm.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <err.h>
+
+#define RECORD_MAGIC "MXSWMREC"
+#define RECORD_VERSION 1
+
+enum record_type {
+	RECORD_XEVENTS = 1,
+	RECORD_KEYACTION,
+	RECORD_CTL
+};
+
+struct record_file {
+	char magic[8];
+	uint32_t version;
+	uint32_t event_size;
+};
+
+struct record {
+	uint32_t type;
+	uint32_t length;
+	uint64_t time;
+};
+
+struct record_keyaction {
+	uint32_t type;
+	uint32_t keycode;
+	uint32_t state;
+};
+
+static FILE *fp;
+static struct timespec start;
+static int replaying;
+static unsigned long keyactions;
+
+static size_t	 event_size(int);
+static void	 write_record(int, const void *, size_t);
+
+static size_t
+event_size(int type)
+{
+	switch (type) {
+	case KeyPress:
+	case KeyRelease:
+		return sizeof(XKeyEvent);
+	case ButtonPress:
+	case ButtonRelease:
+		return sizeof(XButtonEvent);
+	case Expose:
+		return sizeof(XExposeEvent);
+	case CreateNotify:
+		return sizeof(XCreateWindowEvent);
+	case DestroyNotify:
+		return sizeof(XDestroyWindowEvent);
+	case UnmapNotify:
+		return sizeof(XUnmapEvent);
+	case MapNotify:
+		return sizeof(XMapEvent);
+	case MapRequest:
+		return sizeof(XMapRequestEvent);
+	case ReparentNotify:
+		return sizeof(XReparentEvent);
+	case ConfigureNotify:
+		return sizeof(XConfigureEvent);
+	case ConfigureRequest:
+		return sizeof(XConfigureRequestEvent);
+	case PropertyNotify:
+		return sizeof(XPropertyEvent);
+	case ClientMessage:
+		return sizeof(XClientMessageEvent);
+	default:
+		return sizeof(XEvent);
+	}
+}
+
+static void
+write_record(int type, const void *payload, size_t length)
+{
+	struct record r;
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	r.type = type;
+	r.length = length;
+	r.time = (uint64_t) (now.tv_sec - start.tv_sec) * 1000000000 +
+	    now.tv_nsec - start.tv_nsec;
+
+	if (fwrite(&r, sizeof(r), 1, fp) != 1 ||
+	    fwrite(payload, length, 1, fp) != 1) {
+		warn("record");
+		stop_recording();
+	}
+}
+
+int
+start_recording(const char *path)
+{
+	struct record_file header;
+
+	/*
+	 * A replayed log may contain the ctl line that started it.
+	 */
+	if (replaying)
+		return 0;
+
+	if (fp != NULL)
+		stop_recording();
+
+	fp = fopen(path, "w");
+	if (fp == NULL) {
+		warn("%s", path);
+		return -1;
+	}
+
+	memcpy(header.magic, RECORD_MAGIC, sizeof(header.magic));
+	header.version = RECORD_VERSION;
+	header.event_size = sizeof(XEvent);
+	if (fwrite(&header, sizeof(header), 1, fp) != 1) {
+		warn("%s", path);
+		fclose(fp);
+		fp = NULL;
+		return -1;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	return 0;
+}
+
+void
+stop_recording()
+{
+	if (fp == NULL)
+		return;
+
+	if (fclose(fp) != 0)
+		warn("record");
+	fp = NULL;
+}
+
+void
+record_events(XEvent *events, size_t n)
+{
+	char *buf, *p;
+	size_t i, sz, len;
+	uint16_t esz;
+
+	if (fp == NULL)
+		return;
+
+	len = 0;
+	for (i = 0; i < n; i++)
+		len += sizeof(esz) + event_size(events[i].type);
+
+	if ((buf = malloc(len)) == NULL) {
+		warn("malloc");
+		return;
+	}
+	for (i = 0, p = buf; i < n; i++) {
+		sz = event_size(events[i].type);
+		esz = sz;
+		memcpy(p, &esz, sizeof(esz));
+		p += sizeof(esz);
+		memcpy(p, &events[i], sz);
+		p += sz;
+	}
+
+	write_record(RECORD_XEVENTS, buf, len);
+	free(buf);
+}
+
+void
+record_keyaction(XKeyEvent *xkey)
+{
+	struct record_keyaction k;
+
+	if (replaying)
+		keyactions++;
+	if (fp == NULL)
+		return;
+
+	k.type = xkey->type;
+	k.keycode = xkey->keycode;
+	k.state = xkey->state;
+	write_record(RECORD_KEYACTION, &k, sizeof(k));
+}
+
+void
+record_ctl_line(const char *str)
+{
+	if (fp == NULL)
+		return;
+
+	write_record(RECORD_CTL, str, strlen(str));
+}
+
+/*
+ * Returns 1 while a log is being replayed. Key actions are replayed
+ * too, so actions that would reach outside the window manager, such
+ * as running commands or closing clients, check this and do nothing.
+ */
+int
+is_replaying()
+{
+	return replaying;
+}
+
+/*
+ * Feeds a recorded log to handle_events() as fast as possible and
+ * prints a summary line to standard output.
+ *
+ * The recorded windows do not exist on the display the log is
+ * replayed against, so requests about them fail, but the same
+ * requests are still sent. Recorded sequence numbers mean nothing to
+ * this connection, so each event gets the last sequence number known
+ * to be processed, as if it had just been generated.
+ */
+int
+replay(const char *path)
+{
+	FILE *in;
+	struct record_file header;
+	struct record r;
+	struct timespec t0, t1;
+	XEvent *events;
+	char *buf, *p, *end;
+	size_t n, alloc;
+	unsigned long nevents, nbatches, nctl, nkeyactions, request;
+	unsigned long round_trips;
+	double cpu;
+	uint16_t esz;
+
+	if ((in = fopen(path, "r")) == NULL) {
+		warn("%s", path);
+		return -1;
+	}
+	if (fread(&header, sizeof(header), 1, in) != 1 ||
+	    memcmp(header.magic, RECORD_MAGIC, sizeof(header.magic)) != 0 ||
+	    header.version != RECORD_VERSION ||
+	    header.event_size != sizeof(XEvent)) {
+		warnx("%s: not a recording of this build", path);
+		fclose(in);
+		return -1;
+	}
+
+	replaying = 1;
+	nevents = nbatches = nctl = nkeyactions = 0;
+	events = NULL;
+	alloc = 0;
+	buf = NULL;
+
+	XSync(display(), False);
+	request = NextRequest(display());
+	round_trips = round_trip_count();
+	cpu = cpu_time_ms();
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+
+	while (fread(&r, sizeof(r), 1, in) == 1) {
+		free(buf);
+		if ((buf = malloc(r.length + 1)) == NULL)
+			err(1, "malloc");
+		if (r.length > 0 && fread(buf, r.length, 1, in) != 1) {
+			warnx("%s: truncated record", path);
+			break;
+		}
+		buf[r.length] = '\0';
+
+		switch (r.type) {
+		case RECORD_XEVENTS:
+			end = buf + r.length;
+			for (n = 0, p = buf; p + sizeof(esz) <= end; n++) {
+				if (n == alloc) {
+					alloc = alloc ? alloc * 2 : 256;
+					events = realloc(events,
+					    alloc * sizeof(XEvent));
+					if (events == NULL)
+						err(1, "realloc");
+				}
+				memcpy(&esz, p, sizeof(esz));
+				p += sizeof(esz);
+				if (esz > sizeof(XEvent) || p + esz > end)
+					errx(1, "%s: corrupt event", path);
+				memset(&events[n], 0, sizeof(XEvent));
+				memcpy(&events[n], p, esz);
+				events[n].xany.display = display();
+				events[n].xany.serial =
+				    LastKnownRequestProcessed(display());
+				p += esz;
+			}
+			handle_events(events, n);
+			redraw();
+			nevents += n;
+			nbatches++;
+			break;
+		case RECORD_KEYACTION:
+			nkeyactions++;
+			break;
+		case RECORD_CTL:
+			run_ctl_line(buf);
+			nctl++;
+			break;
+		default:
+			warnx("%s: unknown record type %u", path, r.type);
+			break;
+		}
+	}
+	free(buf);
+	free(events);
+	fclose(in);
+
+	XSync(display(), False);
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+
+	printf("events %lu batches %lu ctl %lu keyactions %lu/%lu "
+	    "wall_ms %.3f cpu_ms %.3f requests %lu round_trips %lu\n",
+	    nevents, nbatches, nctl, keyactions, nkeyactions,
+	    (t1.tv_sec - t0.tv_sec) * 1000.0 +
+	    (t1.tv_nsec - t0.tv_nsec) / 1000000.0, cpu_time_ms() - cpu,
+	    NextRequest(display()) - request,
+	    round_trip_count() - round_trips);
+
+	replaying = 0;
+	return 0;
+}
@@ -0,0 +1,84 @@
+/*
+ * ISC License
+ *
+ * Copyright (c) 2022, Tommi Leino <namhas@gmail.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * redraw.c:
+ *   Collects drawing requests while a batch of events is being handled
+ *   and paints each dirty object only once after the batch.
+ */
+
+#include "mxswm.h"
+
+static int _dirty;
+
+static void paint_dirty(void);
+
+void
+mark_dirty(int what)
+{
+	_dirty |= what;
+}
+
+void
+redraw()
+{
+	struct span span;
+
+	if (_dirty != 0) {
+		metric_begin(METRIC_DRAW, &span);
+		paint_dirty();
+		metric_end(METRIC_DRAW, &span);
+	}
+
+	XFlush(display());
+	key_to_focus_flushed();
+}
+
+static void
+paint_dirty()
+{
+	TRACE_LOG("dirty=%d", _dirty);
+
+	/*
+	 * Menus go first because painting them may close the menu
+	 * which in turn marks the current stack dirty.
+	 */
+	if (_dirty & DIRTY_MENU) {
+		_dirty &= ~(DIRTY_MENU | DIRTY_MENU_SELECTION);
+		paint_menu();
+	} else if (_dirty & DIRTY_MENU_SELECTION) {
+		_dirty &= ~DIRTY_MENU_SELECTION;
+		paint_menu_selection();
+	}
+	if (_dirty & DIRTY_GLOBAL_MENU) {
+		_dirty &= ~DIRTY_GLOBAL_MENU;
+		paint_global_menu();
+	}
+	if (_dirty & DIRTY_STACKS) {
+		_dirty &= ~DIRTY_STACKS;
+		paint_stacks();
+	}
+	if (_dirty & DIRTY_STATUSBAR) {
+		_dirty &= ~DIRTY_STATUSBAR;
+		paint_statusbar();
+	}
+	if (_dirty & DIRTY_PROMPT) {
+		_dirty &= ~DIRTY_PROMPT;
+		paint_prompt();
+	}
+}
@@ -24,14 +24,11 @@
 #include <string.h>
 #include <stdio.h>
 
-#include <X11/Xft/Xft.h>
-
 static struct stack *_head;
 static struct stack *_focus;
 static int _highlight;
 static int _stack_height_adj;
 
-static void create_stack_titlebar(struct stack *);
 static int stack_width(int, int, int);
 static struct stack *next_stack(struct stack *);
 static struct stack *prev_stack(struct stack *);
@@ -74,7 +71,7 @@ hide_stack(struct stack *stack)
 {
 	unmap_clients(stack);
 	if (stack->mapped)
-		XUnmapWindow(display(), stack->window);
+		backend->unmap_window(stack->window);
 }
 
 static void
@@ -82,7 +79,7 @@ show_stack(struct stack *stack)
 {
 	resize_clients(stack);
 	if (!stack->mapped)
-		XMapWindow(display(), stack->window);
+		backend->map_window(stack->window);
 	map_clients(stack);
 }
 
@@ -288,109 +285,35 @@ find_stack(int num)
 	return NULL;
 }
 
-static void
-create_stack_titlebar(struct stack *stack)
-{
-	int x, y, w, h;
-	XSetWindowAttributes a;
-	unsigned long v;
-	Display *dpy;
-
-	dpy = display();
-
-	assert(BORDERWIDTH > 0);
-	set_font(FONT_NORMAL);
-	w = BORDERWIDTH;
-	h = get_font_height();
-	x = BORDERWIDTH;
-	y = 0;
-	v = CWBackPixel | CWOverrideRedirect;
-	a.background_pixel = query_color(COLOR_TITLE_BG_NORMAL).pixel;
-	a.override_redirect = True;
-	stack->window = XCreateWindow(dpy,
-	    DefaultRootWindow(dpy),
-	    x, y, w, h, 0, CopyFromParent,
-	    InputOutput, CopyFromParent,
-	    v, &a);
-
-	XSelectInput(dpy, stack->window, ExposureMask);
-	XMapWindow(dpy, stack->window);
-}
-
+/*
+ * Marks stack's titlebar for repainting once the event queue has been
+ * drained, see redraw().
+ */
 void
 draw_stack(struct stack *stack)
 {
-	Display *dpy;
-	struct client *client;
-	char buf[1024], flags[10], num[10];
-	size_t nclients;
-	XGlyphInfo flags_extents;
-	int num_xoff;
-
-	if (stack == NULL || stack->hidden) {
-		TRACE_LOG("not drawing this stack...");
+	if (stack == NULL)
 		return;
-	}
 
-	dpy = display();
-	client = find_top_client(stack);
-
-	nclients = count_clients(stack);
-
-	if (!stack->mapped)
-		XMapWindow(dpy, stack->window);
-
-	XRaiseWindow(dpy, stack->window);
-
-	set_font(FONT_TITLE);
-
-	if (client != NULL && client->renamed_name != NULL)
-		snprintf(buf, sizeof(buf), " %s ", client->renamed_name);
-	else if (client != NULL && client->name != NULL)
-		snprintf(buf, sizeof(buf), " %s ", client->name);
-	else
-		buf[0] = '\0';
-
-	snprintf(num, sizeof(num), " %zu ", nclients);
-
-	if (_highlight && stack == current_stack())
-		snprintf(flags, sizeof(flags), " %d%c%c ",
-		    stack->num,
-		    stack->sticky ? 's' : '-',
-		    stack->prefer_width ? 'w' : '-');
-	else
-		flags[0] = '\0';
-
-	font_extents(flags, strlen(flags), &flags_extents);
-
-	XClearArea(display(), stack->window, 0, 0, stack->width,
-	    get_font_height(), False);
-
-	/*
-	 * Draw number of clients in the stack.
-	 */
-	set_font_color(COLOR_TITLE_FG_NORMAL);
-	num_xoff = draw_font(stack->window, 0, 0, COLOR_TITLE_BG_NUMBER, num);
-
-	/*
-	 * Draw top client title.
-	 */
-	if (menu_has_highlight() && _highlight && stack == current_stack() &&
-	    !is_menu_visible())
-		set_font_color(COLOR_MENU_FG_HIGHLIGHT);
-	else if (_highlight && stack == current_stack() && !is_menu_visible())
-		set_font_color(COLOR_MENU_FG_FOCUS);
-	else
-		set_font_color(COLOR_TITLE_FG_NORMAL);
+	stack->dirty = 1;
+	mark_dirty(DIRTY_STACKS);
+}
 
-	(void) draw_font(stack->window, num_xoff, 0, -1, buf);
+void
+paint_stacks()
+{
+	struct stack *np;
 
-	/*
-	 * Draw stack flags.
-	 */
-	set_font_color(COLOR_TITLE_FG_NORMAL);
-	draw_font(stack->window, stack->width - flags_extents.xOff,
-	    0, -1, flags);
+	for (np = _head; np != NULL; np = np->next) {
+		if (!np->dirty)
+			continue;
+		np->dirty = 0;
+		if (np->hidden) {
+			TRACE_LOG("not drawing this stack...");
+			continue;
+		}
+		paint_titlebar(np, _highlight && np == current_stack());
+	}
 }
 
 void
@@ -422,16 +345,11 @@ renumber_stacks()
 void
 resize_stack(struct stack *stack, unsigned short width)
 {
-	Display *dpy;
-
 	assert(stack != NULL);
 
-	dpy = display();
 	stack->width = width;
-
-	set_font(FONT_TITLE);
-	XMoveResizeWindow(dpy, stack->window, stack->x, 0, stack->width,
-	    get_font_height());
+	backend->move_titlebar(stack->window, stack->x, 0, stack->width,
+	    backend->titlebar_height());
 	resize_clients(stack);
 	draw_stack(stack);
 }
@@ -533,10 +451,13 @@ resize_stacks_for_monitor(int _monitor)
 void
 resize_stacks()
 {
+	struct span span;
 	int i;
 
+	metric_begin(METRIC_LAYOUT, &span);
 	for (i = 0; i < monitors(); i++)
 		resize_stacks_for_monitor(i);
+	metric_end(METRIC_LAYOUT, &span);
 }
 
 void
@@ -564,7 +485,8 @@ adjust_stacks_height(int adj)
 
 	_stack_height_adj = adj;
 	for (np = first_stack(); np != NULL; np = next_stack(np)) {
-		np->height = display_height(np->monitor) - get_font_height() -
+		np->height = display_height(np->monitor) -
+		    backend->titlebar_height() -
 		    _stack_height_adj;
 	}
 
@@ -580,8 +502,7 @@ add_stack_to_monitor(struct stack *after, int monitor)
 	if (stack == NULL)
 		return NULL;
 
-	set_font(FONT_TITLE);
-	stack->height = display_height(monitor) - get_font_height() -
+	stack->height = display_height(monitor) - backend->titlebar_height() -
 	    _stack_height_adj;
 	stack->width = 0;
 	stack->x = monitor_x(monitor);
@@ -608,7 +529,7 @@ add_stack_to_monitor(struct stack *after, int monitor)
 			_head->next->prev = _head;
 	}
 
-	create_stack_titlebar(stack);
+	stack->window = backend->create_titlebar();
 
 	resize_stacks();
 	renumber_stacks();
@@ -652,8 +573,8 @@ remove_stack(struct stack *stack)
 	else if (stack == _head)
 		_head = stack->next;
 
-	XUnmapWindow(display(), stack->window);
-	XDestroyWindow(display(), stack->window);
+	backend->unmap_window(stack->window);
+	backend->destroy_window(stack->window);
 	free(stack);
 
 	dump_stacks();
@@ -688,13 +609,11 @@ focus_stack(struct stack *stack)
 	focus_client(find_top_client(stack), stack);
 
 	if (prev != NULL && prev != _focus) {
-		XSetWindowBackground(display(), prev->window,
-		    query_color(COLOR_TITLE_BG_NORMAL).pixel);
+		backend->highlight_titlebar(prev->window, 0);
 		draw_stack(prev);
 	}
 
-	XSetWindowBackground(display(), stack->window,
-	    query_color(COLOR_TITLE_BG_FOCUS).pixel);
+	backend->highlight_titlebar(stack->window, 1);
 	draw_stack(stack);
 }
 
@@ -783,6 +702,83 @@ current_stack()
 	return _focus;
 }
 
+/*
+ * Returns the focused stack, if any, without creating one.
+ */
+struct stack *
+focused_stack()
+{
+	return _focus;
+}
+
+/*
+ * Replies with one JSON object per stack, for ctl "list stacks".
+ */
+void
+list_stacks()
+{
+	struct stack *np;
+
+	for (np = _head; np != NULL; np = np->next)
+		ctl_reply("{\"num\":%d,\"monitor\":%d,\"x\":%d,\"y\":%d,"
+		    "\"width\":%d,\"height\":%d,\"prefer_width\":%d,"
+		    "\"hidden\":%s,\"sticky\":%s,\"focused\":%s,"
+		    "\"clients\":%zu}\n",
+		    np->num, np->monitor, np->x, np->y, np->width, np->height,
+		    np->prefer_width, np->hidden ? "true" : "false",
+		    np->sticky ? "true" : "false",
+		    np == _focus ? "true" : "false", count_clients(np));
+}
+
+/*
+ * Replies with the visible stacks and the windows in them, top window
+ * first, as one JSON object for ctl "get layout".
+ */
+void
+list_layout()
+{
+	struct stack *np;
+	struct client *client;
+	const char *sep, *wsep;
+	char *buf;
+	size_t sz;
+	FILE *fp;
+
+	buf = NULL;
+	if ((fp = open_memstream(&buf, &sz)) == NULL) {
+		warn("open_memstream");
+		return;
+	}
+
+	if (_focus != NULL)
+		fprintf(fp, "{\"focus\":%d,\"stacks\":[", _focus->num);
+	else
+		fprintf(fp, "{\"focus\":null,\"stacks\":[");
+	sep = "";
+	for (np = _head; np != NULL; np = np->next) {
+		if (np->hidden)
+			continue;
+		fprintf(fp, "%s{\"num\":%d,\"monitor\":%d,\"x\":%d,\"y\":%d,"
+		    "\"width\":%d,\"height\":%d,\"windows\":[", sep,
+		    np->num, np->monitor, np->x, np->y, np->width, np->height);
+		wsep = "";
+		client = NULL;
+		while ((client = next_client(client, np)) != NULL) {
+			fprintf(fp, "%s%lu", wsep, client->window);
+			wsep = ",";
+		}
+		fprintf(fp, "]}");
+		sep = ",";
+	}
+	fprintf(fp, "]}\n");
+
+	if (fclose(fp) == 0)
+		ctl_reply("%s", buf);
+	else
+		warn("fclose");
+	free(buf);
+}
+
 #if (TRACE || TEST)
 #include <inttypes.h>
 #include <stdio.h>
@@ -812,5 +808,7 @@ main(int argc, char *argv[])
 	remove_stack(current_stack());
 	add_stack(current_stack());
 	dump_stacks();
+
+	return 0;
 }
 #endif
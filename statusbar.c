@@ -21,11 +21,159 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <err.h>
 
-static Window _statusbar[16];
+/*
+ * Statusbar content is rendered to canvas pixmaps which are copied to
+ * the statusbar windows. Monitors of the same width share a canvas
+ * unless a monitor has segments of its own, in which case it gets a
+ * private canvas.
+ *
+ * The content consists of left, center and right segments. Text set
+ * by 'status' ctl lines takes precedence over the text of built-in
+ * providers, and the center segment defaults to the root window
+ * title. When a segment changes, only its area on the canvas is
+ * redrawn and copied to the windows.
+ */
+struct canvas {
+	int monitor;
+	unsigned short width;
+	Pixmap pixmap;
+	char *drawn[NUM_SEGMENT];
+	int x[NUM_SEGMENT];
+	int w[NUM_SEGMENT];
+	int damage_x1, damage_x2;
+};
+
+struct statusbar {
+	Window window;
+	int monitor;
+	int canvas;
+	int dirty;
+};
+
+static struct statusbar *_statusbar;
 static int _nstatusbar;
+static struct canvas *_canvas;
+static int _ncanvas;
 static int _visible;
 
+static char *_text[NUM_SEGMENT];
+static char *_provider_text[NUM_SEGMENT];
+static char *(*_monitor_text)[NUM_SEGMENT];
+
+static char *_name;
+static int _name_stale = 1;
+static int _render;
+static GC _gc;
+
+static int
+has_monitor_text(int monitor)
+{
+	int i;
+
+	if (_monitor_text == NULL)
+		return 0;
+
+	for (i = 0; i < NUM_SEGMENT; i++)
+		if (_monitor_text[monitor][i] != NULL)
+			return 1;
+
+	return 0;
+}
+
+static int
+find_canvas(int monitor, unsigned short width)
+{
+	int i;
+
+	for (i = 0; i < _ncanvas; i++)
+		if (_canvas[i].monitor == monitor && _canvas[i].width == width)
+			return i;
+
+	return -1;
+}
+
+static int
+add_canvas(int monitor, unsigned short width, Drawable drawable)
+{
+	struct canvas *canvas;
+	Display *dpy = display();
+
+	canvas = realloc(_canvas, (_ncanvas + 1) * sizeof(struct canvas));
+	if (canvas == NULL)
+		err(1, "realloc");
+	_canvas = canvas;
+
+	canvas = &_canvas[_ncanvas];
+	memset(canvas, 0, sizeof(struct canvas));
+	canvas->monitor = monitor;
+	canvas->width = width;
+	set_font(FONT_NORMAL);
+	canvas->pixmap = XCreatePixmap(dpy, drawable, width, get_font_height(),
+	    DefaultDepth(dpy, DefaultScreen(dpy)));
+	_render = 1;
+
+	return _ncanvas++;
+}
+
+/*
+ * Frees canvases no statusbar uses anymore, e.g. the private canvas of
+ * a monitor whose own segments were all cleared.
+ */
+static void
+free_unused_canvases()
+{
+	int i, j, used;
+
+	for (i = _ncanvas - 1; i >= 0; i--) {
+		for (used = 0, j = 0; j < _nstatusbar && !used; j++)
+			used = (_statusbar[j].canvas == i);
+		if (used)
+			continue;
+
+		XFreePixmap(display(), _canvas[i].pixmap);
+		for (j = 0; j < NUM_SEGMENT; j++)
+			free(_canvas[i].drawn[j]);
+
+		/*
+		 * Move the last canvas to the freed slot.
+		 */
+		_ncanvas--;
+		if (i == _ncanvas)
+			continue;
+		_canvas[i] = _canvas[_ncanvas];
+		for (j = 0; j < _nstatusbar; j++)
+			if (_statusbar[j].canvas == _ncanvas)
+				_statusbar[j].canvas = i;
+	}
+}
+
+/*
+ * Assigns each statusbar a shared canvas, or a private one if it has
+ * segments of its own.
+ */
+static void
+assign_canvases()
+{
+	struct statusbar *sb;
+	int i, monitor;
+	unsigned short width;
+
+	for (i = 0; i < _nstatusbar; i++) {
+		sb = &_statusbar[i];
+		monitor = has_monitor_text(sb->monitor) ? sb->monitor : -1;
+		width = display_width(sb->monitor);
+		if (sb->canvas != -1 && _canvas[sb->canvas].monitor == monitor)
+			continue;
+		if ((sb->canvas = find_canvas(monitor, width)) == -1)
+			sb->canvas = add_canvas(monitor, width, sb->window);
+		sb->dirty = 1;
+	}
+
+	free_unused_canvases();
+}
+
 static void
 create_statusbar()
 {
@@ -33,75 +181,318 @@ create_statusbar()
 	XSetWindowAttributes a;
 	unsigned long v;
 	int i;
+	Display *dpy = display();
+	struct statusbar *sb;
+
+	_statusbar = calloc(monitors(), sizeof(struct statusbar));
+	if (_statusbar == NULL)
+		err(1, "calloc");
 
+	set_font(FONT_NORMAL);
+	h = get_font_height();
 	for (i = 0; i < monitors(); i++) {
 		w = display_width(i);
-		set_font(FONT_NORMAL);
-		h = get_font_height();
 		x = monitor_x(i);
 		y = display_height(i) - h;
 		v = CWBackPixel | CWOverrideRedirect;
 		a.background_pixel = query_color(COLOR_STATUSBAR_BG).pixel;
 		a.override_redirect = True;
-		_statusbar[i] = XCreateWindow(display(),
-		    DefaultRootWindow(display()),
+
+		sb = &_statusbar[i];
+		sb->monitor = i;
+		sb->canvas = -1;
+		sb->window = XCreateWindow(dpy, DefaultRootWindow(dpy),
 		    x, y, w, h, 0, CopyFromParent,
 		    InputOutput, CopyFromParent,
 		    v, &a);
-		XSelectInput(display(), _statusbar[i], ExposureMask);
+		XSelectInput(dpy, sb->window, ExposureMask);
 		_nstatusbar++;
 	}
+
+	_gc = XCreateGC(dpy, _statusbar[0].window, 0, NULL);
+	XSetForeground(dpy, _gc, query_color(COLOR_STATUSBAR_BG).pixel);
+
+	assign_canvases();
 }
 
-void
-draw_statusbar()
+static void
+read_root_name()
 {
-	char *name, *buf;
 	XTextProperty text;
+	Display *dpy = display();
+
+	if (_name != NULL) {
+		free(_name);
+		_name = NULL;
+	}
+
+	get_utf8_property(DefaultRootWindow(dpy), wmh[_NET_WM_NAME], &_name);
+	if (_name != NULL)
+		return;
+
+	if (ROUND_TRIP(XGetWMName(dpy, DefaultRootWindow(dpy), &text)) != 0) {
+		_name = malloc(text.nitems + 1);
+		if (_name != NULL) {
+			memcpy(_name, text.value, text.nitems);
+			_name[text.nitems] = 0;
+		}
+		XFree(text.value);
+	}
+}
+
+static const char *
+segment_text(struct canvas *canvas, int segment)
+{
+	if (canvas->monitor != -1 &&
+	    _monitor_text[canvas->monitor][segment] != NULL)
+		return _monitor_text[canvas->monitor][segment];
+	if (_text[segment] != NULL)
+		return _text[segment];
+	if (_provider_text[segment] != NULL)
+		return _provider_text[segment];
+	if (segment == SEGMENT_CENTER)
+		return _name;
+
+	return NULL;
+}
+
+static void
+damage_canvas(struct canvas *canvas, int x1, int x2)
+{
+	if (canvas->damage_x2 == 0) {
+		canvas->damage_x1 = x1;
+		canvas->damage_x2 = x2;
+	} else {
+		canvas->damage_x1 = MIN(canvas->damage_x1, x1);
+		canvas->damage_x2 = MAX(canvas->damage_x2, x2);
+	}
+}
+
+static void
+draw_segment(struct canvas *canvas, int segment)
+{
+	char buf[1024];
+
+	if (canvas->drawn[segment] == NULL)
+		return;
+
+	snprintf(buf, sizeof(buf), " %s ", canvas->drawn[segment]);
+	set_font_color(COLOR_STATUSBAR_FG);
+	(void) draw_font(canvas->pixmap, canvas->x[segment], 0,
+	    COLOR_STATUSBAR_BG, buf);
+}
+
+/*
+ * Clears the old area of the segment, draws its new content and then
+ * redraws any other segments overlapping the cleared area.
+ */
+static void
+render_segment(struct canvas *canvas, int segment, const char *text)
+{
+	char buf[1024];
 	XGlyphInfo extents;
-	int x;
+	int x1, x2, x, w, i;
+
+	free(canvas->drawn[segment]);
+	canvas->drawn[segment] = NULL;
+	x = w = 0;
+	if (text != NULL && (canvas->drawn[segment] = strdup(text)) != NULL) {
+		snprintf(buf, sizeof(buf), " %s ", text);
+		font_extents(buf, strlen(buf), &extents);
+		w = MIN(extents.xOff, canvas->width);
+		if (segment == SEGMENT_RIGHT)
+			x = canvas->width - w;
+		else if (segment == SEGMENT_CENTER)
+			x = canvas->width / 2 - w / 2;
+	}
+
+	x1 = x;
+	x2 = x + w;
+	if (canvas->w[segment] > 0) {
+		x1 = MIN(x1, canvas->x[segment]);
+		x2 = MAX(x2, canvas->x[segment] + canvas->w[segment]);
+	}
+	canvas->x[segment] = x;
+	canvas->w[segment] = w;
+	if (x2 <= x1)
+		return;
+
+	XFillRectangle(display(), canvas->pixmap, _gc, x1, 0, x2 - x1,
+	    get_font_height());
+	draw_segment(canvas, segment);
+	for (i = 0; i < NUM_SEGMENT; i++)
+		if (i != segment && canvas->w[i] > 0 &&
+		    canvas->x[i] < x2 && canvas->x[i] + canvas->w[i] > x1)
+			draw_segment(canvas, i);
+
+	damage_canvas(canvas, x1, x2);
+}
+
+static int
+text_changed(const char *a, const char *b)
+{
+	if (a == NULL || b == NULL)
+		return a != b;
+
+	return strcmp(a, b) != 0;
+}
+
+static void
+render_canvas(struct canvas *canvas)
+{
+	const char *text;
 	int i;
 
-	if (!_visible)
+	if (_render) {
+		for (i = 0; i < NUM_SEGMENT; i++) {
+			free(canvas->drawn[i]);
+			canvas->drawn[i] = NULL;
+			canvas->w[i] = 0;
+		}
+		XFillRectangle(display(), canvas->pixmap, _gc, 0, 0,
+		    canvas->width, get_font_height());
+		damage_canvas(canvas, 0, canvas->width);
+	}
+
+	for (i = 0; i < NUM_SEGMENT; i++) {
+		text = segment_text(canvas, i);
+		if (text_changed(text, canvas->drawn[i]))
+			render_segment(canvas, i, text);
+	}
+}
+
+/*
+ * Replaces '*p' with a copy of 'text', NULL if empty. Returns 0 if the
+ * text did not change.
+ */
+static int
+set_text(char **p, const char *text)
+{
+	if (text != NULL && text[0] == '\0')
+		text = NULL;
+	if (!text_changed(*p, text))
+		return 0;
+
+	free(*p);
+	*p = NULL;
+	if (text != NULL && (*p = strdup(text)) == NULL)
+		warn("strdup");
+
+	return 1;
+}
+
+/*
+ * Sets the text of a segment on a monitor, or on all monitors if
+ * 'monitor' is -1. NULL or empty text clears the segment.
+ */
+void
+set_statusbar_segment(int monitor, int segment, const char *text)
+{
+	char **p;
+
+	if (monitor >= monitors() || segment < 0 || segment >= NUM_SEGMENT)
 		return;
 
-	for (i = 0; i < monitors(); i++) {
-		XClearWindow(display(), _statusbar[i]);
-
-		set_font_color(COLOR_STATUSBAR_FG);
-
-		get_utf8_property(DefaultRootWindow(display()),
-		    wmh[_NET_WM_NAME], &name);
-
-		if (name == NULL) {
-			if (XGetWMName(display(), DefaultRootWindow(display()),
-			    &text) != 0) {
-				name = malloc(text.nitems + 1);
-				if (name != NULL) {
-					memcpy(name, text.value, text.nitems);
-					name[text.nitems] = 0;
-				}
-			}
+	if (monitor == -1)
+		p = &_text[segment];
+	else {
+		if (_monitor_text == NULL &&
+		    (_monitor_text = calloc(monitors(),
+		    sizeof(*_monitor_text))) == NULL) {
+			warn("calloc");
+			return;
 		}
+		p = &_monitor_text[monitor][segment];
+	}
 
-		if (name != NULL) {
-			buf = malloc(strlen(name) + 3);
-			if (buf) {
-				snprintf(buf, strlen(name) + 3, " %s ", name);
-
-				font_extents(buf, strlen(buf), &extents);
-
-				x = display_width(i) / 2;
-				x -= (extents.xOff / 2);
-				if (x < 0)
-					x = 0;
-				(void) draw_font(_statusbar[i], x, 0,
-				    COLOR_STATUSBAR_BG, buf);
-				free(buf);
-			}
-			free(name);
+	if (!set_text(p, text))
+		return;
+
+	if (monitor != -1)
+		assign_canvases();
+	mark_dirty(DIRTY_STATUSBAR);
+}
+
+/*
+ * Sets the text of the built-in providers shown in a segment on all
+ * monitors. NULL or empty text clears it.
+ */
+void
+set_statusbar_provider_text(int segment, const char *text)
+{
+	if (segment < 0 || segment >= NUM_SEGMENT)
+		return;
+
+	if (set_text(&_provider_text[segment], text))
+		mark_dirty(DIRTY_STATUSBAR);
+}
+
+/*
+ * Root window title changed.
+ */
+void
+update_statusbar_name()
+{
+	_name_stale = 1;
+	mark_dirty(DIRTY_STATUSBAR);
+}
+
+void
+draw_statusbar()
+{
+	_render = 1;
+	mark_dirty(DIRTY_STATUSBAR);
+}
+
+void
+expose_statusbar(Window window)
+{
+	int i;
+
+	for (i = 0; i < _nstatusbar; i++)
+		if (_statusbar[i].window == window)
+			_statusbar[i].dirty = 1;
+	mark_dirty(DIRTY_STATUSBAR);
+}
+
+void
+paint_statusbar()
+{
+	struct statusbar *sb;
+	struct canvas *canvas;
+	int i, x, w;
+
+	if (!_visible || _nstatusbar == 0)
+		return;
+
+	if (_name_stale) {
+		read_root_name();
+		_name_stale = 0;
+	}
+
+	set_font(FONT_NORMAL);
+	for (i = 0; i < _ncanvas; i++)
+		render_canvas(&_canvas[i]);
+	_render = 0;
+
+	for (i = 0; i < _nstatusbar; i++) {
+		sb = &_statusbar[i];
+		canvas = &_canvas[sb->canvas];
+		if (sb->dirty) {
+			x = 0;
+			w = canvas->width;
+		} else {
+			x = canvas->damage_x1;
+			w = canvas->damage_x2 - canvas->damage_x1;
 		}
+		if (w > 0)
+			XCopyArea(display(), canvas->pixmap, sb->window, _gc,
+			    x, 0, w, get_font_height(), x, 0);
+		sb->dirty = 0;
 	}
+
+	for (i = 0; i < _ncanvas; i++)
+		_canvas[i].damage_x1 = _canvas[i].damage_x2 = 0;
 }
 
 int
@@ -109,8 +500,8 @@ is_statusbar(Window window)
 {
 	int i;
 
-	for (i = 0; i < monitors(); i++) {
-		if (window == _statusbar[i])
+	for (i = 0; i < _nstatusbar; i++) {
+		if (window == _statusbar[i].window)
 			return 1;
 	}
 	return 0;
@@ -136,8 +527,8 @@ show_statusbar()
 	adjust_stacks_height(get_font_height() * 1.5);
 
 	if (!_visible) {
-		for (i = 0; i < monitors(); i++)
-			XMapWindow(display(), _statusbar[i]);
+		for (i = 0; i < _nstatusbar; i++)
+			XMapWindow(display(), _statusbar[i].window);
 	}
 }
 
@@ -157,7 +548,7 @@ hide_statusbar()
 	adjust_stacks_height(0);
 
 	if (_visible) {
-		for (i = 0; i < monitors(); i++)
-			XUnmapWindow(display(), _statusbar[i]);
+		for (i = 0; i < _nstatusbar; i++)
+			XUnmapWindow(display(), _statusbar[i].window);
 	}
 }
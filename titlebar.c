@@ -0,0 +1,136 @@
+/*
+ * ISC License
+ *
+ * Copyright (c) 2021, Tommi Leino <namhas@gmail.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * titlebar.c:
+ *   Creates and paints the stack titlebar windows. The stack layout
+ *   itself is in stack.c and does not talk to the X server.
+ */
+
+#include "mxswm.h"
+
+#include <X11/Xft/Xft.h>
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+Window
+create_titlebar()
+{
+	int x, y, w, h;
+	XSetWindowAttributes a;
+	unsigned long v;
+	Display *dpy;
+	Window window;
+
+	dpy = display();
+
+	assert(BORDERWIDTH > 0);
+	set_font(FONT_NORMAL);
+	w = BORDERWIDTH;
+	h = get_font_height();
+	x = BORDERWIDTH;
+	y = 0;
+	v = CWBackPixel | CWOverrideRedirect;
+	a.background_pixel = query_color(COLOR_TITLE_BG_NORMAL).pixel;
+	a.override_redirect = True;
+	window = XCreateWindow(dpy,
+	    DefaultRootWindow(dpy),
+	    x, y, w, h, 0, CopyFromParent,
+	    InputOutput, CopyFromParent,
+	    v, &a);
+
+	XSelectInput(dpy, window, ExposureMask);
+	XMapWindow(dpy, window);
+
+	return window;
+}
+
+/*
+ * Paints the number of clients, the top client's name and, when
+ * highlighted, the stack flags to the stack's titlebar.
+ */
+void
+paint_titlebar(struct stack *stack, int highlight)
+{
+	Display *dpy;
+	struct client *client;
+	char buf[1024], flags[10], num[10];
+	size_t nclients;
+	XGlyphInfo flags_extents;
+	int num_xoff;
+
+	dpy = display();
+	client = find_top_client(stack);
+
+	nclients = count_clients(stack);
+
+	if (!stack->mapped)
+		XMapWindow(dpy, stack->window);
+
+	XRaiseWindow(dpy, stack->window);
+
+	set_font(FONT_TITLE);
+
+	if (client != NULL && client->renamed_name != NULL)
+		snprintf(buf, sizeof(buf), " %s ", client->renamed_name);
+	else if (client != NULL && client->name != NULL)
+		snprintf(buf, sizeof(buf), " %s ", client->name);
+	else
+		buf[0] = '\0';
+
+	snprintf(num, sizeof(num), " %zu ", nclients);
+
+	if (highlight)
+		snprintf(flags, sizeof(flags), " %d%c%c ",
+		    stack->num,
+		    stack->sticky ? 's' : '-',
+		    stack->prefer_width ? 'w' : '-');
+	else
+		flags[0] = '\0';
+
+	font_extents(flags, strlen(flags), &flags_extents);
+
+	XClearArea(dpy, stack->window, 0, 0, stack->width,
+	    get_font_height(), False);
+
+	/*
+	 * Draw number of clients in the stack.
+	 */
+	set_font_color(COLOR_TITLE_FG_NORMAL);
+	num_xoff = draw_font(stack->window, 0, 0, COLOR_TITLE_BG_NUMBER, num);
+
+	/*
+	 * Draw top client title.
+	 */
+	if (menu_has_highlight() && highlight && !is_menu_visible())
+		set_font_color(COLOR_MENU_FG_HIGHLIGHT);
+	else if (highlight && !is_menu_visible())
+		set_font_color(COLOR_MENU_FG_FOCUS);
+	else
+		set_font_color(COLOR_TITLE_FG_NORMAL);
+
+	(void) draw_font(stack->window, num_xoff, 0, -1, buf);
+
+	/*
+	 * Draw stack flags.
+	 */
+	set_font_color(COLOR_TITLE_FG_NORMAL);
+	draw_font(stack->window, stack->width - flags_extents.xOff,
+	    0, -1, flags);
+}
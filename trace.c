@@ -0,0 +1,487 @@
+/*
+ * ISC License
+ *
+ * Copyright (c) 2022, Tommi Leino <namhas@gmail.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * trace.c:
+ *   Always-on tracing to a fixed-size ring of binary records. Each
+ *   TRACE_LOG() stores the time, the event being handled and its
+ *   window, the function, the format string and up to TRACE_ARGS
+ *   arguments, and the start of the first string argument. Formatting
+ *   happens only when the ring is dumped with 'trace' ctl command, or
+ *   to stderr when mxswm crashes.
+ *
+ *   The metrics also record each timed operation, event handling and
+ *   round trip as a span to another ring, so that 'trace json' ctl
+ *   command can write them for a trace viewer.
+ *
+ *   Records are written only by the main loop, a new record overwrites
+ *   the oldest one and nothing is locked.
+ */
+
+#include "mxswm.h"
+
+#include <err.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define NUM_TRACE 4096		/* Power of two. */
+#define TRACE_ARGS 6
+#define TRACE_STR 32
+#define NUM_SPAN 8192		/* Power of two. */
+
+struct trace_record {
+	unsigned long long time;
+	const char *func;
+	const char *fmt;
+	Window window;
+	int event;
+	unsigned long long arg[TRACE_ARGS];
+	char str[TRACE_STR];
+};
+
+/*
+ * A finished metric_begin()/metric_end() pair, see metrics.c.
+ */
+struct span_record {
+	unsigned long long start;
+	unsigned long long duration;
+	int metric;
+	unsigned int requests;
+	unsigned int round_trips;
+};
+
+struct conversion {
+	const char *start;
+	size_t len;
+	char length;
+	char conv;
+};
+
+static struct trace_record ring[NUM_TRACE];
+static unsigned long nrecords;
+static struct span_record spans[NUM_SPAN];
+static unsigned long nspans;
+static struct trace_record snapshot[NUM_TRACE];
+static unsigned long nsnapshot;
+static char snapshot_reason[128];
+static unsigned long long start;
+
+static unsigned long long	 now(void);
+static const char		*next_conversion(const char *,
+				    struct conversion *);
+static int			 format_record(const struct trace_record *,
+				    char *, size_t, int);
+static void			 dump_records(const struct trace_record *,
+				    unsigned long, unsigned long);
+static void			 copy_str(char *, const char *);
+static void			 handle_crash(int);
+
+static unsigned long long
+now()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Finds the next conversion in printf format 'p'. Returns pointer past
+ * it, or NULL if there are no more conversions that can be traced.
+ */
+static const char *
+next_conversion(const char *p, struct conversion *c)
+{
+	while ((p = strchr(p, '%')) != NULL) {
+		c->start = p++;
+		if (*p == '%') {
+			p++;
+			continue;
+		}
+		p += strspn(p, "-+ #0123456789.");
+		c->length = '\0';
+		if (*p == 'l' || *p == 'z' || *p == 'h') {
+			c->length = *p++;
+			if (*p == 'l')
+				c->length = 'L';
+			if (*p == 'l' || *p == 'h')
+				p++;
+		}
+		if (*p == '\0' || strchr("diuxXocsp", *p) == NULL)
+			return NULL;
+		c->conv = *p++;
+		c->len = p - c->start;
+		return p;
+	}
+
+	return NULL;
+}
+
+/*
+ * Copies as much of 's' as fits in a record, cutting it at a UTF-8
+ * character boundary.
+ */
+static void
+copy_str(char *dst, const char *s)
+{
+	const unsigned char *p;
+	size_t n, len;
+
+	p = (const unsigned char *) s;
+	for (n = 0; p[n] != '\0'; n += len) {
+		if ((len = utf8_len(&p[n])) == 0)
+			len = 1;
+		if (n + len > TRACE_STR - 1)
+			break;
+	}
+	memcpy(dst, s, n);
+	dst[n] = '\0';
+}
+
+void
+trace_log(const char *func, const char *fmt, ...)
+{
+	struct trace_record *r;
+	struct conversion c;
+	const char *p, *s;
+	va_list ap;
+	int i;
+
+	r = &ring[nrecords++ & (NUM_TRACE - 1)];
+	r->time = now();
+	r->func = func;
+	r->fmt = fmt;
+	r->window = current_window();
+	r->event = current_event_type();
+	r->str[0] = '\0';
+
+	va_start(ap, fmt);
+	for (i = 0, p = fmt; i < TRACE_ARGS &&
+	    (p = next_conversion(p, &c)) != NULL; i++) {
+		switch (c.conv) {
+		case 's':
+			s = va_arg(ap, const char *);
+			if (r->str[0] == '\0' && s != NULL)
+				copy_str(r->str, s);
+			break;
+		case 'p':
+			r->arg[i] = (unsigned long) va_arg(ap, void *);
+			break;
+		case 'd':
+		case 'i':
+		case 'c':
+			if (c.length == 'L')
+				r->arg[i] = va_arg(ap, long long);
+			else if (c.length == 'l')
+				r->arg[i] = va_arg(ap, long);
+			else if (c.length == 'z')
+				r->arg[i] = va_arg(ap, ssize_t);
+			else
+				r->arg[i] = va_arg(ap, int);
+			break;
+		default:
+			if (c.length == 'L')
+				r->arg[i] = va_arg(ap, unsigned long long);
+			else if (c.length == 'l')
+				r->arg[i] = va_arg(ap, unsigned long);
+			else if (c.length == 'z')
+				r->arg[i] = va_arg(ap, size_t);
+			else
+				r->arg[i] = va_arg(ap, unsigned int);
+			break;
+		}
+	}
+	va_end(ap);
+}
+
+/*
+ * Formats record 'r' as one line to 'buf' like TRACE builds print
+ * them, or only the message if not 'header'. Arguments past TRACE_ARGS
+ * are left out, and only the first string argument is known.
+ */
+static int
+format_record(const struct trace_record *r, char *buf, size_t sz,
+    int header)
+{
+	struct conversion c;
+	const char *p, *q;
+	char spec[32];
+	size_t len;
+	int i, n, nstr;
+
+	len = 0;
+	buf[0] = '\0';
+	if (header)
+		len = snprintf(buf, sz, "%.6f %-16s 0x%08lx %-24s ",
+		    (r->time - start) / 1e9,
+		    r->event != 0 ? str_event_type(r->event) : "-",
+		    r->window, r->func);
+
+	nstr = 0;
+	for (i = 0, p = r->fmt; len < sz; i++) {
+		q = p;
+		if (i == TRACE_ARGS || (p = next_conversion(p, &c)) == NULL)
+			c.start = q + strlen(q);
+		n = snprintf(buf + len, sz - len, "%.*s", (int) (c.start - q),
+		    q);
+		len += n;
+		if (p == NULL || i == TRACE_ARGS || len >= sz)
+			break;
+
+		snprintf(spec, sizeof(spec), "%.*s", (int) c.len, c.start);
+		switch (c.conv) {
+		case 's':
+			n = snprintf(buf + len, sz - len, spec,
+			    nstr++ == 0 ? r->str : "?");
+			break;
+		case 'p':
+			n = snprintf(buf + len, sz - len, spec,
+			    (void *) (unsigned long) r->arg[i]);
+			break;
+		case 'd':
+		case 'i':
+		case 'c':
+			if (c.length == 'L')
+				n = snprintf(buf + len, sz - len, spec,
+				    (long long) r->arg[i]);
+			else if (c.length == 'l' || c.length == 'z')
+				n = snprintf(buf + len, sz - len, spec,
+				    (long) r->arg[i]);
+			else
+				n = snprintf(buf + len, sz - len, spec,
+				    (int) r->arg[i]);
+			break;
+		default:
+			if (c.length == 'L')
+				n = snprintf(buf + len, sz - len, spec,
+				    r->arg[i]);
+			else if (c.length == 'l' || c.length == 'z')
+				n = snprintf(buf + len, sz - len, spec,
+				    (unsigned long) r->arg[i]);
+			else
+				n = snprintf(buf + len, sz - len, spec,
+				    (unsigned int) r->arg[i]);
+			break;
+		}
+		len += n;
+	}
+	if (len >= sz)
+		len = sz - 1;
+
+	/*
+	 * Some formats end in a newline of their own.
+	 */
+	while (len > 0 && buf[len - 1] == '\n')
+		buf[--len] = '\0';
+
+	return len;
+}
+
+/*
+ * Replies to 'trace [N]' ctl command with the last 'n' records, or
+ * with all of them if 'n' is zero.
+ */
+void
+trace_dump(unsigned long n)
+{
+	dump_records(ring, nrecords, n);
+}
+
+static void
+dump_records(const struct trace_record *records, unsigned long count,
+    unsigned long n)
+{
+	char buf[512];
+	unsigned long i, first;
+
+	first = count > NUM_TRACE ? count - NUM_TRACE : 0;
+	if (n > 0 && count - first > n)
+		first = count - n;
+
+	for (i = first; i < count; i++) {
+		format_record(&records[i & (NUM_TRACE - 1)], buf, sizeof(buf),
+		    1);
+		ctl_reply("%s\n", buf);
+	}
+}
+
+/*
+ * Copies the trace ring aside, so that what led to e.g. a slow event
+ * can be looked at later with 'trace snapshot' ctl command. May be
+ * called from a signal handler.
+ */
+void
+trace_snapshot(const char *reason)
+{
+	memcpy(snapshot, ring, sizeof(snapshot));
+	nsnapshot = nrecords;
+	strncpy(snapshot_reason, reason, sizeof(snapshot_reason) - 1);
+	snapshot_reason[sizeof(snapshot_reason) - 1] = '\0';
+}
+
+/*
+ * Replies to 'trace snapshot' ctl command.
+ */
+void
+trace_dump_snapshot()
+{
+	if (nsnapshot == 0) {
+		ctl_reply("no snapshot\n");
+		return;
+	}
+
+	ctl_reply("%s\n", snapshot_reason);
+	dump_records(snapshot, nsnapshot, 0);
+}
+
+void
+trace_span(int metric, unsigned long long begin, unsigned long long ns,
+    unsigned long requests, unsigned long round_trips)
+{
+	struct span_record *s;
+
+	s = &spans[nspans++ & (NUM_SPAN - 1)];
+	s->start = begin;
+	s->duration = ns;
+	s->metric = metric;
+	s->requests = requests;
+	s->round_trips = round_trips;
+}
+
+/*
+ * Writes the spans and the trace records of the last 'seconds' to
+ * 'path' in Chrome trace event format, which e.g. Perfetto opens.
+ * Spans are complete events that nest by time, and trace records are
+ * instant events.
+ */
+int
+trace_export(unsigned long seconds, const char *path)
+{
+	FILE *fp;
+	const struct span_record *s;
+	const struct trace_record *r;
+	unsigned long long since;
+	unsigned long i, first;
+	char buf[512], quoted[sizeof(buf) * 6 + 3];
+	int n, failed;
+
+	since = now() - start;
+	since = seconds * 1000000000ULL < since ?
+	    start + since - seconds * 1000000000ULL : start;
+
+	if ((fp = fopen(path, "w")) == NULL) {
+		warn("%s", path);
+		return -1;
+	}
+
+	fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+	n = 0;
+
+	first = nspans > NUM_SPAN ? nspans - NUM_SPAN : 0;
+	for (i = first; i < nspans; i++) {
+		s = &spans[i & (NUM_SPAN - 1)];
+		if (s->start + s->duration < since)
+			continue;
+		fprintf(fp, "%s\n{\"ph\":\"X\",\"pid\":1,\"tid\":1,"
+		    "\"cat\":\"%s\",\"name\":", n++ > 0 ? "," : "",
+		    s->metric < LASTEvent ? "event" : "wm");
+		fputs(json_quote(metric_name(s->metric), quoted,
+		    sizeof(quoted)), fp);
+		fprintf(fp, ",\"ts\":%.3f,\"dur\":%.3f,\"args\":{"
+		    "\"requests\":%u,\"round_trips\":%u}}",
+		    (s->start - start) / 1e3, s->duration / 1e3,
+		    s->requests, s->round_trips);
+	}
+
+	first = nrecords > NUM_TRACE ? nrecords - NUM_TRACE : 0;
+	for (i = first; i < nrecords; i++) {
+		r = &ring[i & (NUM_TRACE - 1)];
+		if (r->time < since)
+			continue;
+		format_record(r, buf, sizeof(buf), 0);
+		fprintf(fp, "%s\n{\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":1,"
+		    "\"cat\":\"log\",\"name\":", n++ > 0 ? "," : "");
+		fputs(json_quote(r->func, quoted, sizeof(quoted)), fp);
+		fprintf(fp, ",\"ts\":%.3f,\"args\":{\"window\":\"0x%lx\","
+		    "\"message\":", (r->time - start) / 1e3, r->window);
+		fputs(json_quote(buf, quoted, sizeof(quoted)), fp);
+		fprintf(fp, "}}");
+	}
+
+	fprintf(fp, "\n]}\n");
+
+	failed = ferror(fp);
+	if (fclose(fp) == EOF || failed) {
+		warn("%s", path);
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * Writes the trace ring to stderr and dies of the same signal.
+ */
+static void
+handle_crash(int sig)
+{
+	static char buf[512];
+	unsigned long i, first;
+	int n;
+
+	n = snprintf(buf, sizeof(buf), "mxswm: %s, last %lu trace "
+	    "records:\n", strsignal(sig), MIN(nrecords, NUM_TRACE));
+	write(STDERR_FILENO, buf, n);
+
+	first = nrecords > NUM_TRACE ? nrecords - NUM_TRACE : 0;
+	for (i = first; i < nrecords; i++) {
+		n = format_record(&ring[i & (NUM_TRACE - 1)], buf,
+		    sizeof(buf) - 1, 1);
+		buf[n++] = '\n';
+		write(STDERR_FILENO, buf, n);
+	}
+
+	raise(sig);
+}
+
+/*
+ * Sets the start time of the trace and dumps it if mxswm crashes.
+ */
+void
+init_trace()
+{
+	static const int signals[] = {
+		SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT
+	};
+	struct sigaction sa;
+	int i;
+
+	start = now();
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = handle_crash;
+	sa.sa_flags = SA_RESETHAND;
+	sigemptyset(&sa.sa_mask);
+	for (i = 0; i < ARRLEN(signals); i++)
+		if (sigaction(signals[i], &sa, NULL) == -1)
+			warn("sigaction");
+}
@@ -0,0 +1,168 @@
+/*
+ * ISC License
+ *
+ * Copyright (c) 2022, Tommi Leino <namhas@gmail.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * watchdog.c:
+ *   Notices when handling an X event takes longer than the budget, 16
+ *   ms by default, and when the main loop is stuck e.g. waiting for a
+ *   reply from the X server. Either takes a snapshot of the trace ring
+ *   for 'trace snapshot' ctl command.
+ *
+ *   Slow events are noticed once they have been handled. A stuck loop
+ *   is noticed by a one-shot ITIMER_REAL timer that is armed when the
+ *   loop wakes up and disarmed when it goes back to wait for input,
+ *   so an idle window manager gets no signals. If SIGALRM arrives,
+ *   the handler only sets a flag and writes a constant message; the
+ *   snapshot is taken once the loop comes back. SIGALRM is installed
+ *   with SA_RESTART so that it does not disturb blocking calls.
+ */
+
+#include "mxswm.h"
+
+#include <err.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#define STUCK_INTERVAL_MS 1000
+
+static unsigned long long budget_ns = 16 * 1000000ULL;
+static int armed;
+static unsigned long nslow;
+static volatile sig_atomic_t stuck;
+static volatile sig_atomic_t stuck_event;
+static volatile sig_atomic_t nstuck;
+
+static void handle_alarm(int);
+static void arm_watchdog(int);
+
+void
+set_watchdog_budget(int ms)
+{
+	budget_ns = ms * 1000000ULL;
+}
+
+/*
+ * Called after each X event has been handled, with the time it took.
+ */
+void
+watchdog_event(XEvent *event, unsigned long long ns)
+{
+	char reason[128];
+
+	if (budget_ns == 0 || ns <= budget_ns)
+		return;
+
+	nslow++;
+	snprintf(reason, sizeof(reason), "%s on 0x%lx took %.3f ms",
+	    str_event(event), event->xany.window, ns / 1e6);
+	trace_snapshot(reason);
+}
+
+/*
+ * Arms or disarms the stuck loop timer.
+ */
+static void
+arm_watchdog(int on)
+{
+	struct itimerval it;
+
+	memset(&it, 0, sizeof(it));
+	if (on) {
+		it.it_value.tv_sec = STUCK_INTERVAL_MS / 1000;
+		it.it_value.tv_usec = (STUCK_INTERVAL_MS % 1000) * 1000;
+	}
+	if (setitimer(ITIMER_REAL, &it, NULL) == -1)
+		warn("setitimer");
+}
+
+/*
+ * Called by the reactor before and after waiting for input.
+ */
+void
+watchdog_idle(int waiting)
+{
+	char reason[128];
+
+	if (!armed)
+		return;
+
+	if (!waiting) {
+		arm_watchdog(1);
+		return;
+	}
+
+	arm_watchdog(0);
+	if (stuck) {
+		snprintf(reason, sizeof(reason),
+		    "main loop stuck over %d ms in %s", STUCK_INTERVAL_MS,
+		    stuck_event != 0 ? str_event_type(stuck_event) :
+		    "no event");
+		trace_snapshot(reason);
+		stuck = 0;
+	}
+}
+
+/*
+ * Disarms the stuck loop timer, which would otherwise survive exec
+ * when restarting and kill the new image before start_watchdog().
+ */
+void
+disarm_watchdog()
+{
+	arm_watchdog(0);
+}
+
+static void
+handle_alarm(int sig)
+{
+	static const char msg[] = "mxswm: main loop stuck\n";
+
+	stuck = 1;
+	stuck_event = current_event_type();
+	nstuck++;
+	write(STDERR_FILENO, msg, sizeof(msg) - 1);
+}
+
+void
+start_watchdog()
+{
+	struct sigaction sa;
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = handle_alarm;
+	sa.sa_flags = SA_RESTART;
+	sigemptyset(&sa.sa_mask);
+	if (sigaction(SIGALRM, &sa, NULL) == -1) {
+		warn("sigaction");
+		return;
+	}
+	armed = 1;
+}
+
+/*
+ * Replies to 'stats watchdog' ctl command.
+ */
+void
+watchdog_stats()
+{
+	ctl_reply("budget_ms %llu slow %lu stuck %d\n",
+	    budget_ns / 1000000, nslow, (int) nstuck);
+}
@@ -0,0 +1,180 @@
+/*
+ * ISC License
+ *
+ * Copyright (c) 2021, Tommi Leino <namhas@gmail.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * xbackend.c:
+ *   The window system side of stacks and clients, see struct backend.
+ *   stack.c and client.c call only these for talking to the X server.
+ */
+
+#include "mxswm.h"
+
+#include <err.h>
+
+static void x_destroy_window(Window);
+static void x_map_window(Window);
+static void x_unmap_window(Window);
+static void x_raise_window(Window);
+static void x_move_titlebar(Window, int, int, int, int);
+static void x_configure_client(Window, int, int, int, int);
+static void x_highlight_titlebar(Window, int);
+static void x_adopt_client(struct client *);
+static void x_focus_client(struct client *);
+static void x_close_client(struct client *);
+static int x_window_position(Window, int *, int *);
+static int x_titlebar_height(void);
+static unsigned long x_next_request(void);
+
+const struct backend xbackend = {
+	"x11",
+	create_titlebar,
+	x_destroy_window,
+	x_map_window,
+	x_unmap_window,
+	x_raise_window,
+	x_move_titlebar,
+	x_configure_client,
+	x_highlight_titlebar,
+	x_adopt_client,
+	x_focus_client,
+	x_close_client,
+	x_window_position,
+	x_titlebar_height,
+	x_next_request
+};
+
+const struct backend *backend = &xbackend;
+
+static void
+x_destroy_window(Window window)
+{
+	XDestroyWindow(display(), window);
+}
+
+static void
+x_map_window(Window window)
+{
+	XMapWindow(display(), window);
+}
+
+static void
+x_unmap_window(Window window)
+{
+	XUnmapWindow(display(), window);
+}
+
+static void
+x_raise_window(Window window)
+{
+	XRaiseWindow(display(), window);
+}
+
+static void
+x_move_titlebar(Window window, int x, int y, int width, int height)
+{
+	XMoveResizeWindow(display(), window, x, y, width, height);
+}
+
+static void
+x_configure_client(Window window, int x, int y, int width, int height)
+{
+	unsigned long xwcm;
+	XWindowChanges xwc;
+
+	xwcm = (CWX | CWY | CWWidth | CWHeight | CWBorderWidth);
+	xwc.x = x;
+	xwc.y = y;
+	xwc.width = width;
+	xwc.height = height;
+	xwc.border_width = 0;
+	XConfigureWindow(display(), window, xwcm, &xwc);
+}
+
+static void
+x_highlight_titlebar(Window window, int focused)
+{
+	XSetWindowBackground(display(), window, query_color(focused ?
+	    COLOR_TITLE_BG_FOCUS : COLOR_TITLE_BG_NORMAL).pixel);
+}
+
+/*
+ * Starts following the client's property changes and, if it is
+ * already mapped, reads its protocols and names.
+ */
+static void
+x_adopt_client(struct client *client)
+{
+	XSelectInput(display(), client->window, PropertyChangeMask);
+
+	if (client->mapped) {
+		read_protocols(client);
+		update_client_name(client);
+		try_utf8_renamed_name(client);
+	}
+}
+
+static void
+x_focus_client(struct client *client)
+{
+	if (client->flags & CF_HAS_TAKEFOCUS) {
+		TRACE_LOG("Sending TAKEFOCUS");
+		send_take_focus(client);
+	} else {
+		TRACE_LOG("Normal input focus");
+		XSetInputFocus(display(), client->window, RevertToPointerRoot,
+		    CurrentTime);
+	}
+	key_to_focus_sent();
+}
+
+static void
+x_close_client(struct client *client)
+{
+	if (client->flags & CF_HAS_DELWIN)
+		send_delete_window(client);
+	else
+		XDestroyWindow(display(), client->window);
+}
+
+static int
+x_window_position(Window window, int *x, int *y)
+{
+	XWindowAttributes a;
+
+	if (!ROUND_TRIP(XGetWindowAttributes(display(), window, &a))) {
+		warnx("XGetWindowAttributes failed for %lx", window);
+		return 0;
+	}
+
+	*x = a.x;
+	*y = a.y;
+	return 1;
+}
+
+static int
+x_titlebar_height()
+{
+	set_font(FONT_TITLE);
+	return get_font_height();
+}
+
+static unsigned long
+x_next_request()
+{
+	return NextRequest(display());
+}
@@ -0,0 +1,136 @@
+/*
+ * ISC License
+ *
+ * Copyright (c) 2022, Tommi Leino <namhas@gmail.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * xerror.c:
+ *   Permanent handler for X errors.
+ *
+ *   Failed requests are recorded by their sequence number in a ring,
+ *   so that instead of syncing with the server right after a request,
+ *   callers can remember NextRequest() and check later whether the
+ *   request failed. Windows disappear all the time, so errors about
+ *   them are not fatal.
+ */
+
+#include "mxswm.h"
+
+#include <stdio.h>
+#include <err.h>
+
+#define NUM_XERROR 64
+
+struct xerror {
+	unsigned long serial;
+	unsigned char error_code;
+	unsigned char request_code;
+	unsigned char minor_code;
+	XID resourceid;
+};
+
+static struct xerror ring[NUM_XERROR];
+static unsigned long nerrors;
+
+static int handle_xerror(Display *, XErrorEvent *);
+
+static int
+handle_xerror(Display *dpy, XErrorEvent *event)
+{
+	struct xerror *e;
+	char s[256];
+
+	e = &ring[nerrors++ % NUM_XERROR];
+	e->serial = event->serial;
+	e->error_code = event->error_code;
+	e->request_code = event->request_code;
+	e->minor_code = event->minor_code;
+	e->resourceid = event->resourceid;
+
+	TRACE_LOG("serial=%lu error=%d request=%d resource=%lx",
+	    event->serial, event->error_code, event->request_code,
+	    event->resourceid);
+
+	switch (event->error_code) {
+	case BadWindow:
+	case BadDrawable:
+		/*
+		 * The window went away before the request reached the
+		 * server. The events about it will follow.
+		 */
+		break;
+	case BadMatch:
+		/*
+		 * Expected if the request was a probe for InputOnly.
+		 */
+		if (is_probe(event->serial))
+			break;
+		/* FALLTHROUGH */
+	default:
+		XGetErrorText(dpy, event->error_code, s, sizeof(s));
+		warnx("X error: %s, request %d.%d, resource %lx", s,
+		    event->request_code, event->minor_code,
+		    event->resourceid);
+		break;
+	}
+
+	return 0;
+}
+
+void
+set_error_handler()
+{
+	XSetErrorHandler(handle_xerror);
+}
+
+/*
+ * Returns the error code of a failed request, or 0 if the request did
+ * not fail or is too old to be remembered.
+ *
+ * The answer is final only if the server has already processed the
+ * request, that is, if an event or reply with the same or a later
+ * sequence number has been read.
+ */
+int
+x_request_error(unsigned long serial)
+{
+	unsigned long i;
+
+	for (i = nerrors; i > 0 && nerrors - i < NUM_XERROR; i--)
+		if (ring[(i - 1) % NUM_XERROR].serial == serial)
+			return ring[(i - 1) % NUM_XERROR].error_code;
+
+	return 0;
+}
+
+/*
+ * Replies to 'stats errors' ctl command.
+ */
+void
+xerror_stats()
+{
+	struct xerror *e;
+	unsigned long i;
+
+	ctl_reply("errors %lu\n", nerrors);
+	i = (nerrors > NUM_XERROR) ? nerrors - NUM_XERROR : 0;
+	for (; i < nerrors; i++) {
+		e = &ring[i % NUM_XERROR];
+		ctl_reply("serial %lu error %d request %d.%d resource %lx\n",
+		    e->serial, e->error_code, e->request_code, e->minor_code,
+		    e->resourceid);
+	}
+}